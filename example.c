@@ -2,6 +2,11 @@
 
 int main(int argc, char *argv[])
 {
+    // Everything the build allocates goes into one arena, released at the end in a single call
+    Arena session;
+    arena_init(&session, 0);
+    smb_set_arena(&session);
+
     char *c = "    ";
     if (smb_check_tool("gcc")) {
         c = "gcc";
@@ -20,6 +25,8 @@ int main(int argc, char *argv[])
     int r = smb_cmd_run_async(cmd);
     smb_cmd_free(cmd);
 
+    smb_set_arena(NULL);
+    arena_free(&session);
     return EXIT_SUCCESS;
 }
 
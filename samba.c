@@ -1,15 +1,23 @@
 #include "samba.h"
 #include "samba_config.h"
 
+#include <ctype.h>
+
 #ifdef _WIN32
 #include <windows.h>
 #include <process.h>
+#include <sys/utime.h>
 #define snprintf _snprintf
 #define stat _stat
+#ifndef S_ISREG
+#define S_ISREG(mode) (((mode) & S_IFMT) == S_IFREG)
+#endif
 #else
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 #include <stdlib.h>
 // ---- Macros ----
@@ -80,13 +88,19 @@ static inline bool is_admin() {
 
 typedef struct {
     int logging;
+    Arena *arena;
 } SMB_State;
 
 // ------ Variable ------
 SMB_State state = {
-    .logging = 1
+    .logging = 1,
+    .arena = NULL
 };
 
+void smb_set_arena(Arena *arena) {
+    state.arena = arena;
+}
+
 //--------------------
 void smb_log(char *level, const char *msg, ...) {
     if (state.logging) {
@@ -99,11 +113,267 @@ void smb_log(char *level, const char *msg, ...) {
     }
 }
 
+// ------ String builder ------
+
+void smb_str_reserve(SString *str, size_t extra) {
+    if (str->len + extra < str->capacity) return;
+    size_t capacity = str->capacity ? str->capacity * 2 : 64;
+    while (capacity <= str->len + extra) capacity *= 2;
+    char *data = realloc(str->data, capacity);
+    if (!data) {
+        perror("realloc failed");
+        exit(EXIT_FAILURE);
+    }
+    str->data = data;
+    str->capacity = capacity;
+}
+
+void smb_str_append_n(SString *str, const char *text, size_t len) {
+    smb_str_reserve(str, len);
+    memcpy(str->data + str->len, text, len);
+    str->len += len;
+    str->data[str->len] = '\0';
+}
+
+void smb_str_append(SString *str, const char *text) {
+    smb_str_append_n(str, text, strlen(text));
+}
+
+void smb_str_append_char(SString *str, char c) {
+    smb_str_reserve(str, 1);
+    str->data[str->len++] = c;
+    str->data[str->len] = '\0';
+}
+
+void smb_str_vappendf(SString *str, const char *format, va_list args) {
+    // Format into the spare capacity first; only output that does not fit is formatted twice
+    va_list args_copy;
+    va_copy(args_copy, args);
+    size_t spare = str->capacity - str->len;
+    int length = vsnprintf(spare ? str->data + str->len : NULL, spare, format, args);
+    if (length >= 0 && (size_t)length >= spare) {
+        smb_str_reserve(str, (size_t)length);
+        vsnprintf(str->data + str->len, str->capacity - str->len, format, args_copy);
+    }
+    va_end(args_copy);
+    if (length > 0) str->len += (size_t)length;
+}
+
+void smb_str_appendf(SString *str, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    smb_str_vappendf(str, format, args);
+    va_end(args);
+}
+
+void smb_str_reset(SString *str) {
+    str->len = 0;
+    if (str->data) str->data[0] = '\0';
+}
+
+char *smb_str_release(SString *str) {
+    char *data = str->data;
+    if (!data) data = strdup("");
+    str->data = NULL;
+    str->len = 0;
+    str->capacity = 0;
+    return data;
+}
+
+void smb_str_free(SString *str) {
+    free(str->data);
+    str->data = NULL;
+    str->len = 0;
+    str->capacity = 0;
+}
+
+// ------ Build state ------
+
+typedef struct {
+    uint64_t hash;
+    int64_t mtime;
+    int64_t size;
+    int64_t inputs;  // newest input mtime when the output was last built, 0 if unknown
+} SMB_Record;
+
+typedef struct {
+    int existed;
+    uint64_t hash;
+    struct stat st;
+} SMB_Stamp;
+
+static HashMap smb_db;
+static int smb_db_loaded = 0;
+// Newest input mtime seen by smb_needs_update for outputs that are about to be rebuilt
+static HashMap smb_pending_inputs;
+
+static int64_t smb_mtime_ns(const struct stat *st) {
+#if defined(__APPLE__)
+    return (int64_t)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return (int64_t)st->st_mtime * 1000000000;
+#else
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+static void smb_db_set(const char *path, SMB_Record record) {
+    void **slot = hashmap_put_str(&smb_db, path);
+    if (!*slot) *slot = malloc(sizeof(SMB_Record));
+    *(SMB_Record *)*slot = record;
+}
+
+static void smb_db_write(FILE *f, const char *path, const SMB_Record *record) {
+    fprintf(f, "%016llx %lld %lld %lld %s\n", (unsigned long long)record->hash, (long long)record->mtime,
+            (long long)record->size, (long long)record->inputs, path);
+}
+
+// The db is an append-only log; later lines win, and it is compacted when mostly stale.
+// A log without the current header is from an older format and is dropped.
+static void smb_db_load(void) {
+    if (smb_db_loaded) return;
+    smb_db_loaded = 1;
+
+    FILE *f = fopen(SMB_DB_FILE, "r");
+    if (!f) return;
+
+    char line[4096];
+    size_t lines = 0;
+    int current = fgets(line, sizeof(line), f) && strcmp(line, SMB_DB_HEADER "\n") == 0;
+    while (current && fgets(line, sizeof(line), f)) {
+        SMB_Record record;
+        unsigned long long hash;
+        long long mtime, size, inputs;
+        int path_at = 0;
+        if (sscanf(line, "%llx %lld %lld %lld %n", &hash, &mtime, &size, &inputs, &path_at) != 4 || !path_at) continue;
+        line[strcspn(line, "\n")] = '\0';
+        record.hash = hash;
+        record.mtime = mtime;
+        record.size = size;
+        record.inputs = inputs;
+        smb_db_set(line + path_at, record);
+        lines++;
+    }
+    fclose(f);
+
+    if (!current || lines > smb_db.size * 2 + 64) {
+        f = fopen(SMB_DB_FILE, "w");
+        if (!f) return;
+        fputs(SMB_DB_HEADER "\n", f);
+        size_t it = 0;
+        for (HashMapEntry *entry; (entry = hashmap_next(&smb_db, &it)); ) {
+            smb_db_write(f, entry->key.str, entry->value);
+        }
+        fclose(f);
+    }
+}
+
+static void smb_db_record(const char *path, SMB_Record record) {
+    smb_db_load();
+    smb_db_set(path, record);
+
+    FILE *f = fopen(SMB_DB_FILE, "a");
+    if (!f) return;
+    if (ftell(f) == 0) fputs(SMB_DB_HEADER "\n", f);
+    smb_db_write(f, path, &record);
+    fclose(f);
+}
+
+static int smb_restore_mtime(const char *path, const struct stat *st) {
+#if defined(_WIN32)
+    struct _utimbuf times = { st->st_atime, st->st_mtime };
+    return _utime(path, &times);
+#elif defined(__APPLE__)
+    struct timespec times[2] = { st->st_atimespec, st->st_mtimespec };
+    return utimensat(AT_FDCWD, path, times, 0);
+#else
+    struct timespec times[2] = { st->st_atim, st->st_mtim };
+    return utimensat(AT_FDCWD, path, times, 0);
+#endif
+}
+
+// Captures each declared output before the command runs
+static SMB_Stamp *smb_restat_begin(SCmd *cmd) {
+    size_t count = SCmdOutputs_len(&(cmd->outputs));
+    if (count == 0) return NULL;
+
+    SMB_Stamp *stamps = calloc(count, sizeof(SMB_Stamp));
+    if (!stamps) return NULL;
+
+    smb_db_load();
+    for (size_t i = 0; i < count; i++) {
+        const char *path = cmd->outputs.data[i];
+        if (stat(path, &stamps[i].st) != 0) continue;
+
+        SMB_Record *record = hashmap_get_str(&smb_db, path);
+        if (record && record->mtime == smb_mtime_ns(&stamps[i].st) &&
+            record->size == (int64_t)stamps[i].st.st_size) {
+            stamps[i].hash = record->hash;
+            stamps[i].existed = 1;
+        } else {
+            stamps[i].existed = smb_hash_file(path, &stamps[i].hash);
+        }
+    }
+    return stamps;
+}
+
+// Outputs whose content did not change get their old mtime back, so dependents stay clean
+static void smb_restat_end(SCmd *cmd, SMB_Stamp *stamps, int rt) {
+    size_t count = SCmdOutputs_len(&(cmd->outputs));
+    cmd->dirty = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const char *path = cmd->outputs.data[i];
+        struct stat st;
+        uint64_t hash;
+        if (rt != 0 || stat(path, &st) != 0 || !smb_hash_file(path, &hash)) {
+            cmd->dirty++;
+            continue;
+        }
+
+        if (stamps && stamps[i].existed && stamps[i].hash == hash &&
+            smb_restore_mtime(path, &stamps[i].st) == 0) {
+            smb_log("RESTAT", "'%s' unchanged", path);
+            st = stamps[i].st;
+        } else {
+            cmd->dirty++;
+        }
+
+        // A restored output stays older than the input that triggered the rebuild, so the newest
+        // input mtime is what smb_needs_update compares against next time (as ninja's restat does)
+        SMB_Record record = { hash, smb_mtime_ns(&st), (int64_t)st.st_size, 0 };
+        int64_t *inputs = NULL;
+        if (hashmap_remove_str(&smb_pending_inputs, path, (void **)&inputs)) {
+            record.inputs = *inputs;
+            free(inputs);
+        }
+        smb_db_record(path, record);
+    }
+    free(stamps);
+}
+
 // ------ CMD ------
 
+// A bare program name is replaced by its resolved path, so the shell skips its own PATH search
+static const char *smb_cmd_program(const char *arg) {
+    for (const char *p = arg; *p; p++) {
+        if (!(isalnum((unsigned char)*p) || *p == '.' || *p == '_' || *p == '-' || *p == '+')) return arg;
+    }
+    char *path = smb_which(arg);
+    if (!path || strpbrk(path, " \t\"'")) return arg;
+    return path;
+}
+
 SCmd *smb_cmd_create() {
-    SCmd *cmd = malloc(sizeof(SCmd));
-    vector_init(&(cmd->c), 5, sizeof(char *));
+    SCmd *cmd = state.arena ? arena_alloc(state.arena, sizeof(SCmd)) : malloc(sizeof(SCmd));
+    if (!cmd) {
+        perror("malloc failed");
+        return NULL;
+    }
+    SCmdArgs_init(&(cmd->c));
+    SCmdOutputs_init(&(cmd->outputs));
+    cmd->dirty = 0;
+    cmd->arena = state.arena;
     return cmd;
 }
 
@@ -120,109 +390,45 @@ void smb_cmd_append(SCmd *cmd, char *fmt, ...) {
         return;
     }
 
-    char *fmt_copy = strdup(buffer);
-    if (!fmt_copy) {
-        perror("strdup failed");
-        return;
-    }
-    vector_push(&(cmd->c), &fmt_copy);
+    // Arguments repeat across thousands of commands (flags, include dirs), so each is stored once
+    SCmdArgs_push(&(cmd->c), intern(buffer));
 
     va_start(args, fmt);
     char *arg;
     while ((arg = va_arg(args, char *)) != NULL) {
-        char *arg_copy = strdup(arg);
-        if (!arg_copy) {
-            perror("strdup failed");
-            va_end(args);
-            return;
-        }
-        vector_push(&(cmd->c), &arg_copy);
+        SCmdArgs_push(&(cmd->c), intern(arg));
     }
     va_end(args);
 }
 
 
-int smb_cmd_run_sync(SCmd *cmd) {
-    size_t buffer_size = 256;
-    char *r = malloc(buffer_size);
-    if (!r) {
-        perror("malloc failed");
-        return -1;
-    }
-    r[0] = '\0';
-    
-    for (size_t i = 0; i < vector_len(&(cmd->c)); i++) {
-        char *arg = vector_get_str(&(cmd->c), i);
-        size_t current_len = strlen(r);
-        size_t arg_len = strlen(arg);
-        
-        if (i > 0 && current_len > 0) {
-            if (current_len + arg_len + 2 > buffer_size) {
-                buffer_size *= 2;
-                r = realloc(r, buffer_size);
-                if (!r) {
-                    perror("realloc failed");
-                    return -1;
-                }
-            }
-            strcat(r, " ");
-        }
-        
-        if (current_len + arg_len + 1 > buffer_size) { 
-            buffer_size *= 2;
-            r = realloc(r, buffer_size);
-            if (!r) {
-                perror("realloc failed");
-                return -1;
-            }
-        }
-        strcat(r, arg);
+// The command line: arguments joined by spaces, the program resolved through PATH
+static char *smb_cmd_render(SCmd *cmd) {
+    SString line = {0};
+    for (size_t i = 0; i < cmd->c.size; i++) {
+        const char *arg = cmd->c.data[i];
+        if (i == 0) arg = smb_cmd_program(arg);
+        if (line.len > 0) smb_str_append_char(&line, ' ');
+        smb_str_append(&line, arg);
     }
+    return smb_str_release(&line);
+}
+
+int smb_cmd_run_sync(SCmd *cmd) {
+    char *r = smb_cmd_render(cmd);
     smb_log("CMD", "%s", r);
+    SMB_Stamp *stamps = smb_restat_begin(cmd);
     int rt = system(r);
     free(r);
+    smb_restat_end(cmd, stamps, rt);
     
     return rt;
 }
 
 int smb_cmd_run_async(SCmd *cmd) {
-    size_t buffer_size = 256;
-    char *r = malloc(buffer_size);
-    if (!r) {
-        perror("malloc failed");
-        return -1;
-    }
-    r[0] = '\0';
-    
-    for (size_t i = 0; i < vector_len(&(cmd->c)); i++) {
-        char *arg = vector_get_str(&(cmd->c), i);
-        size_t current_len = strlen(r);
-        size_t arg_len = strlen(arg);
-        
-        if (i > 0 && current_len > 0) {
-            if (current_len + arg_len + 2 > buffer_size) {
-                buffer_size *= 2;
-                r = realloc(r, buffer_size);
-                if (!r) {
-                    perror("realloc failed");
-                    return -1;
-                }
-            }
-            strcat(r, " ");
-        }
-        
-        if (current_len + arg_len + 1 > buffer_size) {
-            buffer_size *= 2;
-            r = realloc(r, buffer_size);
-            if (!r) {
-                perror("realloc failed");
-                return -1;
-            }
-        }
-        
-        strcat(r, arg);
-    }
+    char *r = smb_cmd_render(cmd);
     smb_log("CMD", "%s", r); 
+    SMB_Stamp *stamps = smb_restat_begin(cmd);
 #ifdef _WIN32
     STARTUPINFO si;
     PROCESS_INFORMATION pi;
@@ -234,6 +440,7 @@ int smb_cmd_run_async(SCmd *cmd) {
     if (!CreateProcess(NULL, r, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi)) {
         perror("CreateProcess failed");
         free(r);
+        free(stamps);
         return -1;
     }
     
@@ -246,12 +453,14 @@ int smb_cmd_run_async(SCmd *cmd) {
     CloseHandle(pi.hThread);
     
     free(r);
+    smb_restat_end(cmd, stamps, (int)exitCode);
     return (int)exitCode;
 #else
     pid_t pid = fork();
     if (pid < 0) {
         perror("fork failed");
         free(r);
+        free(stamps);
         return -1;
     }
     
@@ -265,18 +474,24 @@ int smb_cmd_run_async(SCmd *cmd) {
     waitpid(pid, &status, 0);
     
     free(r);
+    smb_restat_end(cmd, stamps, WEXITSTATUS(status));
     return WEXITSTATUS(status);
 #endif
 }
 
-void smb_cmd_free(SCmd *cmd) {
-    vector_free(&(cmd->c));
-    free(cmd);
+void smb_cmd_output(SCmd *cmd, const char *path) {
+    SCmdOutputs_push(&(cmd->outputs), intern(path));
 }
 
 void smb_cmd_reset(SCmd *cmd) {
-    smb_cmd_free(cmd);
-    vector_init(&(cmd->c), 5, sizeof(char *));
+    SCmdArgs_free(&(cmd->c));
+    SCmdOutputs_free(&(cmd->outputs));
+    cmd->dirty = 0;
+}
+
+void smb_cmd_free(SCmd *cmd) {
+    smb_cmd_reset(cmd);
+    if (!cmd->arena) free(cmd);
 }
 
 // --------------------------------------------------------
@@ -300,29 +515,273 @@ char* smb_args_shift(int *argc, char ***argv) {
     return first_arg;
 }
 
-int smb_check_tool(const char *tool) {
-    char command[256];
-#ifndef _WIN32 
-    snprintf(command, sizeof(command), "which %s > /dev/null 2>&1", tool);
-#else 
-    snprintf(command, sizeof(command), "where %s > nul 2>&1", tool);
+// ------ Tool lookup ------
+
+static HashMap smb_tools;
+static char *smb_tools_path = NULL;
+
+static int smb_is_executable(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+#ifdef _WIN32
+    return 1;
+#else
+    return access(path, X_OK) == 0;
 #endif
-    return (system(command) == 0);
 }
 
-int smb_check_library(const char *lib) {
-    if (smb_check_tool("pkg-config")) {
-        char command[256];
+static char *smb_search_path(const char *tool) {
 #ifdef _WIN32
-        snprintf(command, sizeof(command), "pkg-config --exists %s", lib);
-        return (system(command) == 0);
+    const char sep = ';';
+    const char *exts[] = { "", ".exe", ".bat", ".cmd" };
 #else
-        snprintf(command, sizeof(command), "pkg-config --exists %s 2>/dev/null", lib);
-        if (system(command) == 0) {
-            return 1;
+    const char sep = ':';
+    const char *exts[] = { "" };
+#endif
+    char candidate[4096];
+
+    if (strchr(tool, '/')
+#ifdef _WIN32
+        || strchr(tool, '\\')
+#endif
+    ) {
+        return smb_is_executable(tool) ? strdup(tool) : NULL;
+    }
+
+    const char *path = getenv("PATH");
+    for (const char *dir = path; dir; ) {
+        const char *end = strchr(dir, sep);
+        int len = end ? (int)(end - dir) : (int)strlen(dir);
+        for (size_t e = 0; e < sizeof(exts) / sizeof(exts[0]); e++) {
+            // An empty PATH entry means the current directory
+            snprintf(candidate, sizeof(candidate), "%.*s%s%s%s", len, dir, len ? "/" : "./", tool, exts[e]);
+            if (smb_is_executable(candidate)) return strdup(candidate);
+        }
+        dir = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+char *smb_which(const char *tool) {
+    const char *path = getenv("PATH");
+    if (!path) path = "";
+
+    // Memoized per PATH value; a changed PATH drops every answer
+    if (!smb_tools_path || strcmp(smb_tools_path, path) != 0) {
+        size_t it = 0;
+        for (HashMapEntry *entry; (entry = hashmap_next(&smb_tools, &it)); ) free(entry->value);
+        hashmap_clear(&smb_tools);
+        free(smb_tools_path);
+        smb_tools_path = strdup(path);
+    }
+
+    void **slot = hashmap_put_str(&smb_tools, tool);
+    if (!*slot) {
+        char *found = smb_search_path(tool);
+        *slot = found ? found : strdup("");
+    }
+    char *result = *slot;
+    return result[0] ? result : NULL;
+}
+
+int smb_check_tool(const char *tool) {
+    return smb_which(tool) != NULL;
+}
+
+// ------ Library lookup ------
+
+static HashMap smb_libraries;
+static Vector smb_library_dirs;
+
+// Directories registered here are searched before the system ones, like -L
+void smb_add_library_path(const char *dir) {
+    if (smb_library_dirs.data == NULL) vector_init(&smb_library_dirs, 4, sizeof(char *));
+    char *dir_copy = strdup(dir);
+    if (!dir_copy) {
+        perror("strdup failed");
+        return;
+    }
+    vector_push(&smb_library_dirs, &dir_copy);
+}
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#define SMB_LDCACHE_OLD "ld.so-1.7.0"
+#define SMB_LDCACHE_NEW "glibc-ld.so.cache1.1"
+
+// Required-arch bits of an entry's flags, as written by ldconfig
+#if defined(__x86_64__)
+#define SMB_LDCACHE_ARCH 0x0300
+#elif defined(__aarch64__)
+#define SMB_LDCACHE_ARCH 0x0a00
+#endif
+
+static const char *smb_ldcache = NULL;
+static size_t smb_ldcache_size = 0;
+static int smb_ldcache_mapped = 0;
+
+static void smb_ldcache_map(void) {
+    if (smb_ldcache_mapped) return;
+    smb_ldcache_mapped = 1;
+
+    int fd = open("/etc/ld.so.cache", O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            smb_ldcache = map;
+            smb_ldcache_size = (size_t)st.st_size;
         }
+    }
+    close(fd);
+}
+
+static const char *smb_ldcache_string(const char *base, uint32_t offset) {
+    if (base + offset < smb_ldcache || base + offset >= smb_ldcache + smb_ldcache_size) return NULL;
+    const char *s = base + offset;
+    return memchr(s, '\0', smb_ldcache + smb_ldcache_size - s) ? s : NULL;
+}
+
+// Looks `name` up in /etc/ld.so.cache; an exact match wins over a versioned `name.N` soname,
+// which is only returned when `versioned_ok` is set
+static char *smb_ldcache_lookup(const char *name, int versioned_ok) {
+    smb_ldcache_map();
+    if (!smb_ldcache) return NULL;
+
+    const char *header = smb_ldcache;
+    const char *entries = NULL;
+    const char *strings = NULL;
+    size_t count = 0, entry_size = 0;
+
+    if (smb_ldcache_size >= 16 && memcmp(header, SMB_LDCACHE_OLD, sizeof(SMB_LDCACHE_OLD) - 1) == 0) {
+        uint32_t old_count;
+        memcpy(&old_count, header + 12, 4);
+        entries = header + 16;
+        count = old_count;
+        entry_size = 12;
+        strings = entries + count * entry_size;
+
+        // Old-format caches may carry the new format right after them, 8-byte aligned
+        size_t aligned = (16 + count * 12 + 7) & ~(size_t)7;
+        if (aligned + 48 <= smb_ldcache_size &&
+            memcmp(header + aligned, SMB_LDCACHE_NEW, sizeof(SMB_LDCACHE_NEW) - 1) == 0) {
+            header += aligned;
+            entries = NULL;
+        }
+    }
+    if (!entries) {
+        if ((size_t)(header - smb_ldcache) + 48 > smb_ldcache_size ||
+            memcmp(header, SMB_LDCACHE_NEW, sizeof(SMB_LDCACHE_NEW) - 1) != 0) {
+            return NULL;
+        }
+        uint32_t new_count;
+        memcpy(&new_count, header + 20, 4);
+        entries = header + 48;
+        count = new_count;
+        entry_size = 24;
+        strings = header;
+    }
+    if (count > (smb_ldcache_size - (size_t)(entries - smb_ldcache)) / entry_size) return NULL;
+
+    size_t name_len = strlen(name);
+    const char *versioned = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const char *entry = entries + i * entry_size;
+        int32_t flags;
+        uint32_t key_offset, value_offset;
+        memcpy(&flags, entry, 4);
+        memcpy(&key_offset, entry + 4, 4);
+        memcpy(&value_offset, entry + 8, 4);
+
+#ifdef SMB_LDCACHE_ARCH
+        if ((flags & 0xff00) != SMB_LDCACHE_ARCH) continue;
+#endif
+        const char *key = smb_ldcache_string(strings, key_offset);
+        if (!key || strncmp(key, name, name_len) != 0) continue;
+        if (key[name_len] != '\0' && key[name_len] != '.') continue;
+        const char *value = smb_ldcache_string(strings, value_offset);
+        if (!value) continue;
+
+        if (key[name_len] == '\0') return strdup(value);
+        if (!versioned) versioned = value;
+    }
+    return versioned && versioned_ok ? strdup(versioned) : NULL;
+}
+#endif
+
+static char *smb_library_in_dir(const char *dir, const char *lib) {
+#ifdef __APPLE__
+    const char *formats[] = { "%s/lib%s.dylib", "%s/lib%s.a", "%s/%s.dylib", "%s/%s.a" };
+#else
+    const char *formats[] = { "%s/lib%s.so", "%s/lib%s.a", "%s/%s.so", "%s/%s.a" };
 #endif
+    char path[4096];
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        snprintf(path, sizeof(path), formats[i], dir, lib);
+        if (smb_file_exists(path)) return strdup(path);
+    }
+    return NULL;
+}
+
+static char *smb_search_library(const char *lib) {
+    for (size_t i = 0; i < vector_len(&smb_library_dirs); i++) {
+        char *found = smb_library_in_dir(vector_get_str(&smb_library_dirs, i), lib);
+        if (found) return found;
     }
+    // Libraries built next to the build script, as smb_check_library has always found them
+    char *local = smb_library_in_dir(".", lib);
+    if (local) return local;
+
+#if defined(__linux__) && !defined(__ANDROID__)
+    char soname[512];
+    snprintf(soname, sizeof(soname), "lib%s.so", lib);
+    char *cached = smb_ldcache_lookup(soname, 0);
+    if (cached) return cached;
+#endif
+
+#ifndef _WIN32
+    const char *dirs[] = {
+#if defined(__APPLE__)
+        "/opt/homebrew/lib", "/usr/local/lib", "/usr/lib",
+#else
+        "/usr/local/lib",
+#if defined(__x86_64__)
+        "/usr/lib/x86_64-linux-gnu", "/lib/x86_64-linux-gnu",
+#elif defined(__aarch64__)
+        "/usr/lib/aarch64-linux-gnu", "/lib/aarch64-linux-gnu",
+#elif defined(__i386__)
+        "/usr/lib/i386-linux-gnu", "/lib/i386-linux-gnu",
+#endif
+        "/usr/lib64", "/lib64", "/usr/lib", "/lib",
+#endif
+    };
+    for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+        char *found = smb_library_in_dir(dirs[i], lib);
+        if (found) return found;
+    }
+#endif
+
+#if defined(__linux__) && !defined(__ANDROID__)
+    // Runtime-only libraries (no dev symlink) still count as present
+    return smb_ldcache_lookup(soname, 1);
+#else
+    return NULL;
+#endif
+}
+
+// Full path of the library `-l<lib>` would pick, or NULL; memoized for the whole run
+char *smb_find_library(const char *lib) {
+    void **slot = hashmap_put_str(&smb_libraries, lib);
+    if (!*slot) {
+        char *found = smb_search_library(lib);
+        *slot = found ? found : strdup("");
+    }
+    char *result = *slot;
+    return result[0] ? result : NULL;
+}
+
+int smb_check_library(const char *lib) {
+    if (smb_find_library(lib)) return 1;
 
 #ifdef _WIN32
     char libname[256];
@@ -336,56 +795,76 @@ int smb_check_library(const char *lib) {
         FreeLibrary(handle);
         return 1;
     }
+#endif
+
+    // Packages whose name differs from the library file (gtk+-3.0, ...)
+    if (smb_check_tool("pkg-config")) {
+        char command[256];
+#ifdef _WIN32
+        snprintf(command, sizeof(command), "pkg-config --exists %s", lib);
 #else
-    char libname[256];
-    void *handle = NULL;
-    
-#ifdef __APPLE__
-    const char *formats[] = {
-        "lib%s.dylib",
-        "%s.dylib",
-        "lib%s.a",
-        "%s.a",
-        "/usr/lib/lib%s.dylib",
-        "/usr/local/lib/lib%s.dylib"
-    };
-#else
-    const char *formats[] = {
-        "lib%s.so",
-        "%s.so", 
-        "lib%s.a",
-        "%s.a",
-        "/usr/lib/lib%s.so",
-        "/usr/lib64/lib%s.so",
-        "/usr/local/lib/lib%s.so"
-    };
+        snprintf(command, sizeof(command), "pkg-config --exists %s 2>/dev/null", lib);
 #endif
+        if (system(command) == 0) return 1;
+    }
 
-    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
-        snprintf(libname, sizeof(libname), formats[i], lib);
-        
-        if (strstr(libname, ".a")) {
-            FILE *f = fopen(libname, "r");
-            if (f) {
-                fclose(f);
-                return 1;
-            }
+    return 0;
+}
+
+int smb_read_depfile(const char *path, Vector *inputs) {
+    size_t size;
+    char *text = smb_read_file(path, &size);
+    if (!text) return -1;
+
+    Vector tokens;
+    vector_init_ops(&tokens, 64, sizeof(Token), &vector_ops_plain);
+    vector_tokenize(&tokens, text, size, " \t\r\n", TOKENIZE_DEPFILE);
+
+    // Everything but the targets before each rule's colon is a prerequisite
+    int added = 0;
+    Token *slices = tokens.data;
+    for (size_t i = 0; i < tokens.size; i++) {
+        if (slices[i].flags & TOKEN_TARGET) continue;
+        char *input = token_dup(&slices[i], TOKENIZE_DEPFILE);
+        vector_push(inputs, &input);
+        added++;
+    }
+
+    vector_free(&tokens);
+    free(text);
+    return added;
+}
+
+// Outputs that restat left untouched are compared against the newest input mtime recorded when
+// they were last built instead of their own (older) mtime
+int smb_needs_update(const char *output, Vector *inputs) {
+    struct stat output_stat, input_stat;
+    int64_t newest = 0;
+    int stale = 0;
+    for (size_t i = 0; i < vector_len(inputs); i++) {
+        const char *input = vector_get_str(inputs, i);
+        if (stat(input, &input_stat) != 0) {
+            stale = 1;
             continue;
         }
+        if (smb_mtime_ns(&input_stat) > newest) newest = smb_mtime_ns(&input_stat);
     }
-    
-#if defined(__linux__) && !defined(__ANDROID__)
-    char ldconfig_cmd[256];
-    snprintf(ldconfig_cmd, sizeof(ldconfig_cmd), 
-             "ldconfig -p 2>/dev/null | grep -q \"lib%s\\.so\"", lib);
-    if (system(ldconfig_cmd) == 0) {
-        return 1;
-    }
-#endif
 
-#endif
+    if (!stale && stat(output, &output_stat) == 0) {
+        int64_t built = smb_mtime_ns(&output_stat);
+        smb_db_load();
+        SMB_Record *record = hashmap_get_str(&smb_db, output);
+        if (record && record->mtime == built && record->size == (int64_t)output_stat.st_size &&
+            record->inputs > built) {
+            built = record->inputs;
+        }
+        if (newest <= built) return 0;
+    }
 
-    return 0;
+    void **slot = hashmap_put_str(&smb_pending_inputs, output);
+    if (!*slot) *slot = malloc(sizeof(int64_t));
+    if (*slot) *(int64_t *)*slot = newest;
+    return 1;
 }
 
 static int smb_needs_rebuild(const char *source_file, const char *executable) {
@@ -414,7 +893,7 @@ void smb_rebuild_urself() {
 
     if (smb_needs_rebuild(source_file, executable) == 1) {
         SCmd *cmd = smb_cmd_create();
-        smb_cmd_append(cmd, "gcc -o samba samba.c -O2 -s");
+        smb_cmd_append(cmd, "gcc -o samba samba.c -O2 -s", NULL);
         smb_log("INFO", "Rebuilding '%s' from source '%s'.\n", executable, source_file);
         if (smb_cmd_run_async(cmd) != 0) {
             smb_log("ERROR", "Rebuild failed");
@@ -423,7 +902,7 @@ void smb_rebuild_urself() {
         smb_log("INFO", "Build completed successfully.\n");
         system("clear");
         smb_cmd_reset(cmd);
-        smb_cmd_append(cmd, "./samba");
+        smb_cmd_append(cmd, "./samba", NULL);
         if (smb_cmd_run_async(cmd) != 0) {
             smb_log("ERROR", "Rerunning failed\n");
         }
@@ -431,27 +910,33 @@ void smb_rebuild_urself() {
 }
 
 
-char *smb_format(const char *format, ...) {
-    va_list args, args_copy;
-    char *buffer = NULL;
-    int length;
+static char *smb_vformat(Arena *arena, const char *format, va_list args) {
     if (format == NULL)
         return NULL;
+    SString out = {0};
+    smb_str_reserve(&out, strlen(format) + 64);
+    smb_str_vappendf(&out, format, args);
+    if (!arena) return smb_str_release(&out);
+
+    char *buffer = arena_strndup(arena, out.data, out.len);
+    smb_str_free(&out);
+    return buffer;
+}
+
+char *smb_format(const char *format, ...) {
+    va_list args;
     va_start(args, format);
-    va_copy(args_copy, args);
-    length = vsnprintf(NULL, 0, format, args);
+    char *buffer = smb_vformat(state.arena, format, args);
     va_end(args);
+    return buffer;
+}
 
-    if (length < 0)
-        return NULL;
-    buffer = (char *)malloc(length + 1);
-    if (buffer == NULL) {
-        va_end(args_copy);
-        return NULL;
-    }
-    vsnprintf(buffer, length + 1, format, args_copy);
-    va_end(args_copy);
-
+// Always on the heap, for results samba.c frees itself
+static char *smb_format_heap(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    char *buffer = smb_vformat(NULL, format, args);
+    va_end(args);
     return buffer;
 }
 
@@ -462,3 +947,565 @@ char *smb_hnull(void) {
     return "> /dev/null 2>&1";
 #endif
 }
+
+// ------ Hash ------
+
+#define SMB_HASH_P1 0x9E3779B185EBCA87ULL
+#define SMB_HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define SMB_HASH_P3 0x165667B19E3779F9ULL
+#define SMB_HASH_P4 0x85EBCA77C2B2AE63ULL
+#define SMB_HASH_P5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t smb_rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t smb_read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t smb_read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t smb_hash_round(uint64_t acc, uint64_t input) {
+    acc += input * SMB_HASH_P2;
+    acc = smb_rotl64(acc, 31);
+    return acc * SMB_HASH_P1;
+}
+
+static inline uint64_t smb_hash_merge(uint64_t acc, uint64_t val) {
+    acc ^= smb_hash_round(0, val);
+    return acc * SMB_HASH_P1 + SMB_HASH_P4;
+}
+
+// xxHash64 layout: four 8-byte lanes per 32-byte stripe, then a tail
+uint64_t smb_hash(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const unsigned char *limit = end - 32;
+        uint64_t v1 = SMB_HASH_P1 + SMB_HASH_P2;
+        uint64_t v2 = SMB_HASH_P2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - SMB_HASH_P1;
+        do {
+            v1 = smb_hash_round(v1, smb_read64(p));      p += 8;
+            v2 = smb_hash_round(v2, smb_read64(p));      p += 8;
+            v3 = smb_hash_round(v3, smb_read64(p));      p += 8;
+            v4 = smb_hash_round(v4, smb_read64(p));      p += 8;
+        } while (p <= limit);
+        h = smb_rotl64(v1, 1) + smb_rotl64(v2, 7) + smb_rotl64(v3, 12) + smb_rotl64(v4, 18);
+        h = smb_hash_merge(h, v1);
+        h = smb_hash_merge(h, v2);
+        h = smb_hash_merge(h, v3);
+        h = smb_hash_merge(h, v4);
+    } else {
+        h = SMB_HASH_P5;
+    }
+
+    h += (uint64_t)len;
+    while (p + 8 <= end) {
+        h ^= smb_hash_round(0, smb_read64(p));
+        h = smb_rotl64(h, 27) * SMB_HASH_P1 + SMB_HASH_P4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)smb_read32(p) * SMB_HASH_P1;
+        h = smb_rotl64(h, 23) * SMB_HASH_P2 + SMB_HASH_P3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * SMB_HASH_P5;
+        h = smb_rotl64(h, 11) * SMB_HASH_P1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= SMB_HASH_P2;
+    h ^= h >> 29;
+    h *= SMB_HASH_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+char *smb_read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    if (fseek(f, 0, SEEK_END) != 0) {
+        fclose(f);
+        return NULL;
+    }
+    long len = ftell(f);
+    if (len < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    char *data = malloc((size_t)len + 1);
+    if (!data) {
+        fclose(f);
+        return NULL;
+    }
+    if (fread(data, 1, (size_t)len, f) != (size_t)len) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    data[len] = '\0';
+    if (size) *size = (size_t)len;
+    return data;
+}
+
+int smb_hash_file(const char *path, uint64_t *hash) {
+    size_t size;
+    char *data = smb_read_file(path, &size);
+    if (!data) return 0;
+    *hash = smb_hash(data, size);
+    free(data);
+    return 1;
+}
+
+// ------ Archive ------
+
+#define SMB_AR_MAGIC     "!<arch>\n"
+#define SMB_AR_MAGIC_LEN 8
+#define SMB_AR_HDR_LEN   60
+
+typedef struct {
+    char *name;
+    const unsigned char *data;
+    size_t size;
+    long data_offset;   // offset of the member data in the old archive, -1 if new
+    int changed;
+} SMB_ArMember;
+
+typedef struct {
+    const char *name;
+    size_t member;
+} SMB_ArSymbol;
+
+VECTOR_DEFINE(SMB_ArMembers, SMB_ArMember)
+VECTOR_DEFINE(SMB_ArSymbols, SMB_ArSymbol)
+
+static const char *smb_basename(const char *path) {
+    const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char *bslash = strrchr(path, '\\');
+    if (bslash && (!slash || bslash > slash)) slash = bslash;
+#endif
+    return slash ? slash + 1 : path;
+}
+
+static uint64_t smb_elf_read(const unsigned char *p, int width, int big) {
+    uint64_t v = 0;
+    for (int i = 0; i < width; i++) {
+        int shift = big ? (width - 1 - i) * 8 : i * 8;
+        v |= (uint64_t)p[i] << shift;
+    }
+    return v;
+}
+
+// Collects the global symbols an ELF relocatable defines, the same set `ar s` indexes
+static void smb_elf_symbols(const unsigned char *data, size_t size, size_t member, SMB_ArSymbols *symbols) {
+    if (size < 16 || memcmp(data, "\x7f" "ELF", 4) != 0) return;
+
+    int is64 = data[4] == 2;
+    int big = data[5] == 2;
+    if (size < (is64 ? 64 : 52)) return; // ELF header
+    if (smb_elf_read(data + 16, 2, big) != 1) return; // ET_REL
+
+    uint64_t shoff     = is64 ? smb_elf_read(data + 40, 8, big) : smb_elf_read(data + 32, 4, big);
+    uint64_t shentsize = smb_elf_read(data + (is64 ? 58 : 46), 2, big);
+    uint64_t shnum     = smb_elf_read(data + (is64 ? 60 : 48), 2, big);
+    if (shoff == 0 || shnum == 0 || shentsize < (is64 ? 64 : 40)) return;
+    if (shoff > size || shentsize * shnum > size - shoff) return;
+
+    for (uint64_t i = 0; i < shnum; i++) {
+        const unsigned char *sh = data + shoff + i * shentsize;
+        if (smb_elf_read(sh + 4, 4, big) != 2) continue; // SHT_SYMTAB
+
+        uint64_t sym_off  = is64 ? smb_elf_read(sh + 24, 8, big) : smb_elf_read(sh + 16, 4, big);
+        uint64_t sym_size = is64 ? smb_elf_read(sh + 32, 8, big) : smb_elf_read(sh + 20, 4, big);
+        uint64_t link     = smb_elf_read(sh + (is64 ? 40 : 24), 4, big);
+        uint64_t entsize  = is64 ? smb_elf_read(sh + 56, 8, big) : smb_elf_read(sh + 36, 4, big);
+        if (link >= shnum || entsize < (is64 ? 24 : 16) || sym_off > size || sym_size > size - sym_off) continue;
+        if (link * shentsize > size - shoff - shentsize) continue;
+
+        const unsigned char *str_sh = data + shoff + link * shentsize;
+        uint64_t str_off  = is64 ? smb_elf_read(str_sh + 24, 8, big) : smb_elf_read(str_sh + 16, 4, big);
+        uint64_t str_size = is64 ? smb_elf_read(str_sh + 32, 8, big) : smb_elf_read(str_sh + 20, 4, big);
+        if (str_off > size || str_size > size - str_off || str_size == 0) continue;
+        const char *strtab = (const char *)data + str_off;
+
+        for (uint64_t s = 1; s < sym_size / entsize; s++) {
+            const unsigned char *sym = data + sym_off + s * entsize;
+            uint64_t name  = smb_elf_read(sym, 4, big);
+            uint64_t info  = is64 ? sym[4] : sym[12];
+            uint64_t shndx = smb_elf_read(sym + (is64 ? 6 : 14), 2, big);
+            int bind = (int)(info >> 4);
+
+            if (bind != 1 && bind != 2 && bind != 10) continue; // GLOBAL, WEAK, GNU_UNIQUE
+            if (shndx == 0 || name == 0 || name >= str_size) continue;
+            if (!memchr(strtab + name, '\0', str_size - name)) continue;
+
+            SMB_ArSymbol symbol = { strtab + name, member };
+            SMB_ArSymbols_push(symbols, symbol);
+        }
+    }
+}
+
+static char *smb_ar_member_name(const char *raw, const char *longnames, size_t longnames_size) {
+    if (raw[0] == '/' && raw[1] >= '0' && raw[1] <= '9') {
+        size_t offset = strtoul(raw + 1, NULL, 10);
+        if (!longnames || offset >= longnames_size) return NULL;
+        const char *start = longnames + offset;
+        const char *end = start;
+        while (end < longnames + longnames_size && *end != '/' && *end != '\n') end++;
+        return strndup(start, end - start);
+    }
+
+    size_t len = 16;
+    while (len > 0 && raw[len - 1] == ' ') len--;
+    if (len > 0 && raw[len - 1] == '/') len--;
+    return strndup(raw, len);
+}
+
+// Parses an existing GNU archive; `symtab` receives the raw symbol table member if present
+static int smb_ar_parse(const unsigned char *data, size_t size, SMB_ArMembers *members,
+                        const unsigned char **symtab, size_t *symtab_size) {
+    if (size < SMB_AR_MAGIC_LEN || memcmp(data, SMB_AR_MAGIC, SMB_AR_MAGIC_LEN) != 0) return 0;
+
+    const char *longnames = NULL;
+    size_t longnames_size = 0;
+    size_t pos = SMB_AR_MAGIC_LEN;
+
+    while (pos + SMB_AR_HDR_LEN <= size) {
+        const char *hdr = (const char *)data + pos;
+        if (hdr[58] != '`' || hdr[59] != '\n') return 0;
+
+        char size_field[11];
+        memcpy(size_field, hdr + 48, 10);
+        size_field[10] = '\0';
+        size_t member_size = strtoul(size_field, NULL, 10);
+        size_t data_pos = pos + SMB_AR_HDR_LEN;
+        if (member_size > size - data_pos) return 0;
+
+        if (memcmp(hdr, "/ ", 2) == 0) {
+            *symtab = data + data_pos;
+            *symtab_size = member_size;
+        } else if (memcmp(hdr, "// ", 3) == 0) {
+            longnames = (const char *)data + data_pos;
+            longnames_size = member_size;
+        } else if (memcmp(hdr, "/SYM64/", 7) != 0) {
+            SMB_ArMember member = { 0 };
+            member.name = smb_ar_member_name(hdr, longnames, longnames_size);
+            if (!member.name) return 0;
+            member.data = data + data_pos;
+            member.size = member_size;
+            member.data_offset = (long)data_pos;
+            SMB_ArMembers_push(members, member);
+        }
+
+        pos = data_pos + member_size + (member_size & 1);
+    }
+    return 1;
+}
+
+static void smb_ar_put32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+// Space-padded, never NUL-terminated header field
+static void smb_ar_field(char *field, size_t width, const char *value) {
+    size_t len = strlen(value);
+    memset(field, ' ', width);
+    memcpy(field, value, len < width ? len : width);
+}
+
+static void smb_ar_header(char *hdr, const char *name, size_t size, const char *mode) {
+    char size_field[24];
+    snprintf(size_field, sizeof(size_field), "%zu", size);
+    smb_ar_field(hdr, 16, name);
+    smb_ar_field(hdr + 16, 12, "0");
+    smb_ar_field(hdr + 28, 6, "0");
+    smb_ar_field(hdr + 34, 6, "0");
+    smb_ar_field(hdr + 40, 8, mode);
+    smb_ar_field(hdr + 48, 10, size_field);
+    hdr[58] = '`';
+    hdr[59] = '\n';
+}
+
+static int smb_ar_long_name(const char *name) {
+    return strlen(name) > 15 || strchr(name, ' ') || strchr(name, '/');
+}
+
+// Builds the GNU `/` symbol table for the given member order; offsets point at member headers
+static unsigned char *smb_ar_build_symtab(SMB_ArMembers *members, SMB_ArSymbols *symbols, size_t longnames_size,
+                                          size_t *out_size) {
+    size_t count = symbols->size;
+    if (count == 0) {
+        *out_size = 0;
+        return NULL;
+    }
+
+    size_t strings = 0;
+    for (size_t i = 0; i < count; i++) {
+        strings += strlen(symbols->data[i].name) + 1;
+    }
+    size_t symtab_size = 4 + 4 * count + strings;
+    symtab_size += symtab_size & 1; // like the long-name table, GNU counts the padding in the size
+
+    size_t pos = SMB_AR_MAGIC_LEN + SMB_AR_HDR_LEN + symtab_size + (symtab_size & 1);
+    if (longnames_size) pos += SMB_AR_HDR_LEN + longnames_size + (longnames_size & 1);
+
+    size_t num_members = members->size;
+    uint32_t *offsets = malloc(sizeof(uint32_t) * (num_members ? num_members : 1));
+    unsigned char *symtab = calloc(1, symtab_size);
+    if (!offsets || !symtab) {
+        free(offsets);
+        free(symtab);
+        return NULL;
+    }
+    for (size_t i = 0; i < num_members; i++) {
+        SMB_ArMember *member = &members->data[i];
+        offsets[i] = (uint32_t)pos;
+        pos += SMB_AR_HDR_LEN + member->size + (member->size & 1);
+    }
+
+    smb_ar_put32(symtab, (uint32_t)count);
+    unsigned char *names = symtab + 4 + 4 * count;
+    for (size_t i = 0; i < count; i++) {
+        SMB_ArSymbol *symbol = &symbols->data[i];
+        size_t len = strlen(symbol->name) + 1;
+        smb_ar_put32(symtab + 4 + 4 * i, offsets[symbol->member]);
+        memcpy(names, symbol->name, len);
+        names += len;
+    }
+
+    free(offsets);
+    *out_size = symtab_size;
+    return symtab;
+}
+
+static int smb_ar_write_full(const char *archive, SMB_ArMembers *members, const unsigned char *symtab,
+                             size_t symtab_size, const char *longnames, size_t longnames_size) {
+    char *tmp = smb_format_heap("%s.tmp", archive);
+    FILE *f = tmp ? fopen(tmp, "wb") : NULL;
+    if (!f) {
+        smb_log("ERROR", "Cannot write archive '%s'", archive);
+        free(tmp);
+        return -1;
+    }
+
+    char hdr[SMB_AR_HDR_LEN];
+    fwrite(SMB_AR_MAGIC, 1, SMB_AR_MAGIC_LEN, f);
+    if (symtab_size) {
+        smb_ar_header(hdr, "/", symtab_size, "0");
+        fwrite(hdr, 1, SMB_AR_HDR_LEN, f);
+        fwrite(symtab, 1, symtab_size, f);
+        if (symtab_size & 1) fputc('\n', f);
+    }
+    if (longnames_size) {
+        smb_ar_header(hdr, "//", longnames_size, "");
+        memset(hdr + 16, ' ', 32); // GNU leaves date/uid/gid/mode blank here
+        fwrite(hdr, 1, SMB_AR_HDR_LEN, f);
+        fwrite(longnames, 1, longnames_size, f);
+    }
+
+    size_t longname_offset = 0;
+    for (size_t i = 0; i < members->size; i++) {
+        SMB_ArMember *member = &members->data[i];
+        char name[32];
+        if (smb_ar_long_name(member->name)) {
+            snprintf(name, sizeof(name), "/%zu", longname_offset);
+            longname_offset += strlen(member->name) + 2;
+        } else {
+            snprintf(name, sizeof(name), "%s/", member->name);
+        }
+        smb_ar_header(hdr, name, member->size, "644");
+        fwrite(hdr, 1, SMB_AR_HDR_LEN, f);
+        fwrite(member->data, 1, member->size, f);
+        if (member->size & 1) fputc('\n', f);
+    }
+
+    if (ferror(f) | fclose(f)) {
+        smb_log("ERROR", "Failed writing archive '%s'", archive);
+        remove(tmp);
+        free(tmp);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(archive);
+#endif
+    if (rename(tmp, archive) != 0) {
+        smb_log("ERROR", "Cannot replace archive '%s'", archive);
+        remove(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+    return 1;
+}
+
+static int smb_ar_patch(const char *archive, SMB_ArMembers *members) {
+    FILE *f = fopen(archive, "r+b");
+    if (!f) return -1;
+    for (size_t i = 0; i < members->size; i++) {
+        SMB_ArMember *member = &members->data[i];
+        if (!member->changed) continue;
+        if (fseek(f, member->data_offset, SEEK_SET) != 0 ||
+            fwrite(member->data, 1, member->size, f) != member->size) {
+            fclose(f);
+            return -1;
+        }
+    }
+    return fclose(f) == 0 ? 1 : -1;
+}
+
+int smb_ar_write(const char *archive, Vector *objects) {
+    SMB_ArMembers members;
+    SMB_ArSymbols symbols;
+    Vector buffers;
+    SMB_ArMembers_init(&members, vector_len(objects) + 1);
+    SMB_ArSymbols_init(&symbols, 64);
+    vector_init(&buffers, vector_len(objects) + 1, sizeof(char *));
+
+    const unsigned char *old_symtab = NULL;
+    size_t old_symtab_size = 0;
+    size_t old_size = 0;
+    char *old = smb_read_file(archive, &old_size);
+    if (old) {
+        vector_push(&buffers, &old);
+        if (!smb_ar_parse((unsigned char *)old, old_size, &members, &old_symtab, &old_symtab_size)) {
+            smb_log("WARN", "'%s' is not a valid archive, rewriting it", archive);
+            for (size_t i = 0; i < members.size; i++) free(members.data[i].name);
+            members.size = 0;
+            old_symtab = NULL;
+            old_symtab_size = 0;
+        }
+    }
+    size_t old_count = members.size;
+
+    int result = 0;
+    int added = 0, changed = 0, same_layout = 1;
+    for (size_t i = 0; i < vector_len(objects); i++) {
+        const char *path = vector_get_str(objects, i);
+        size_t size;
+        char *data = smb_read_file(path, &size);
+        if (!data) {
+            smb_log("ERROR", "Cannot read archive member '%s'", path);
+            result = -1;
+            goto done;
+        }
+        vector_push(&buffers, &data);
+
+        const char *name = smb_basename(path);
+        SMB_ArMember *existing = NULL;
+        for (size_t m = 0; m < members.size; m++) {
+            SMB_ArMember *candidate = &members.data[m];
+            if (strcmp(candidate->name, name) == 0) {
+                existing = candidate;
+                break;
+            }
+        }
+
+        if (existing) {
+            if (existing->size == size &&
+                smb_hash(existing->data, existing->size) == smb_hash(data, size)) {
+                continue;
+            }
+            if (existing->size != size || existing->data_offset < 0) same_layout = 0;
+            existing->data = (unsigned char *)data;
+            existing->size = size;
+            existing->changed = 1;
+            changed++;
+        } else {
+            SMB_ArMember member = { 0 };
+            member.name = strdup(name);
+            member.data = (unsigned char *)data;
+            member.size = size;
+            member.data_offset = -1;
+            member.changed = 1;
+            SMB_ArMembers_push(&members, member);
+            added++;
+        }
+    }
+
+    if (old && added == 0 && changed == 0) {
+        smb_log("AR", "'%s' is up to date", archive);
+        goto done;
+    }
+
+    for (size_t i = 0; i < members.size; i++) {
+        SMB_ArMember *member = &members.data[i];
+        smb_elf_symbols(member->data, member->size, i, &symbols);
+    }
+
+    size_t longnames_size = 0;
+    for (size_t i = 0; i < members.size; i++) {
+        SMB_ArMember *member = &members.data[i];
+        if (smb_ar_long_name(member->name)) longnames_size += strlen(member->name) + 2;
+    }
+    longnames_size += longnames_size & 1; // GNU counts the padding as part of the table
+    char *longnames = NULL;
+    if (longnames_size) {
+        longnames = malloc(longnames_size);
+        if (!longnames) {
+            result = -1;
+            goto done;
+        }
+        vector_push(&buffers, &longnames);
+        char *out = longnames;
+        for (size_t i = 0; i < members.size; i++) {
+            SMB_ArMember *member = &members.data[i];
+            if (!smb_ar_long_name(member->name)) continue;
+            size_t len = strlen(member->name);
+            memcpy(out, member->name, len);
+            out[len] = '/';
+            out[len + 1] = '\n';
+            out += len + 2;
+        }
+        if (out < longnames + longnames_size) *out = '\n';
+    }
+
+    size_t symtab_size = 0;
+    unsigned char *symtab = smb_ar_build_symtab(&members, &symbols, longnames_size, &symtab_size);
+    if (symtab) vector_push(&buffers, &symtab);
+
+    // Same sizes and an identical index leave every offset where it was: patch the data only
+    if (old && added == 0 && same_layout && old_count == members.size &&
+        symtab_size == old_symtab_size &&
+        (symtab_size == 0 || memcmp(symtab, old_symtab, symtab_size) == 0)) {
+        result = smb_ar_patch(archive, &members);
+        if (result == 1) {
+            smb_log("AR", "Updated %d member(s) of '%s' in place", changed, archive);
+            goto done;
+        }
+    }
+
+    result = smb_ar_write_full(archive, &members, symtab, symtab_size, longnames, longnames_size);
+    if (result == 1) {
+        smb_log("AR", "Wrote '%s' (%zu members, %zu symbols)", archive,
+                members.size, symbols.size);
+    }
+
+done:
+    for (size_t i = 0; i < members.size; i++) free(members.data[i].name);
+    SMB_ArMembers_free(&members);
+    SMB_ArSymbols_free(&symbols);
+    vector_free(&buffers);
+    return result;
+}
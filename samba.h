@@ -9,16 +9,48 @@
 #include <string.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "vector.h"
 
+// Most commands have a few arguments and at most a couple of outputs, so both live inline in the SCmd
+// Both hold interned strings (see intern() in vector.h)
+SMALL_VECTOR_DEFINE(SCmdArgs, const char *, 16)
+SMALL_VECTOR_DEFINE(SCmdOutputs, const char *, 2)
+
 typedef struct {
-    Vector c;
+    SCmdArgs c;
+    SCmdOutputs outputs;  // files the command writes; unchanged ones keep their mtime
+    int dirty;       // outputs whose content changed on the last run
+    Arena *arena;    // session arena the command and its strings live in, NULL for the heap
 } SCmd;
 
+// Growable string with amortized O(1) appends. A zero-initialized SString is empty and ready to
+// use, data is NUL-terminated after any append and reset keeps the buffer for reuse.
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} SString;
+
+void      smb_str_reserve(SString *, size_t);
+void      smb_str_append(SString *, const char *);
+void      smb_str_append_n(SString *, const char *, size_t);
+void      smb_str_append_char(SString *, char);
+void      smb_str_appendf(SString *, const char *, ...);
+void      smb_str_vappendf(SString *, const char *, va_list);
+void      smb_str_reset(SString *);
+char *    smb_str_release(SString *);
+void      smb_str_free(SString *);
+
 void      smb_log(char *, const char *, ...);
+// Commands and smb_format results created while an arena is set come from it and are released
+// by arena_reset/arena_free; smb_cmd_free on them only returns argument lists that outgrew SCmd.
+// Command arguments and outputs are interned and never freed.
+void      smb_set_arena(Arena *);
 SCmd*     smb_cmd_create();
 void      smb_cmd_append(SCmd *, char *, ...);
+void      smb_cmd_output(SCmd *, const char *);
 int       smb_cmd_run_sync(SCmd *);
 int       smb_cmd_run_async(SCmd *);
 void      smb_cmd_reset(SCmd *);
@@ -27,8 +59,21 @@ void      smb_cmd_free(SCmd *);
 char *    smb_args_shift(int *, char ***);
 void      smb_rebuild_urself();
 int       smb_file_exists(const char *);
+int       smb_needs_update(const char *, Vector *);
+int       smb_read_depfile(const char *, Vector *);
 int       smb_check_tool(const char *);
+char *    smb_which(const char *);
+char *    smb_find_library(const char *);
+void      smb_add_library_path(const char *);
 int       smb_check_library(const char *);
 char *    smb_format(const char *, ...);
 char *    smb_hnull();
+
+uint64_t  smb_hash(const void *, size_t);
+int       smb_hash_file(const char *, uint64_t *);
+char *    smb_read_file(const char *, size_t *);
+// Adds or replaces the objects in a static library, patching member data in place when sizes
+// and the symbol index are unchanged. Returns 1 if the archive was written, 0 if it was already
+// up to date and -1 on error.
+int       smb_ar_write(const char *, Vector *);
 #endif
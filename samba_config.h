@@ -1,7 +1,12 @@
 #ifndef SMB_CONFIG_H
 #define SMB_CONFIG_H
 
-#define SMB_VERSION 2.0
+#define SMB_VERSION 2.1
+
+// Build state (output hashes) used for restat, relative to the working directory
+#define SMB_DB_FILE ".samba_db"
+// First line of SMB_DB_FILE; records are "hash mtime size newest-input-mtime path"
+#define SMB_DB_HEADER "# samba db v2"
 
 
 #endif // SMB_CONFIG_H
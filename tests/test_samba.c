@@ -0,0 +1,164 @@
+#include "../samba.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+static void write_file(const char *path, const char *text) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+    fputs(text, file);
+    fclose(file);
+}
+
+// ------ Depfiles ------
+
+static void test_depfile_multiple_targets(void) {
+    write_file("deps.d", "a.o b.o: x.c \\\n y.h\n");
+    Vector inputs;
+    vector_init_ops(&inputs, 4, sizeof(char *), &vector_ops_string);
+    CHECK(smb_read_depfile("deps.d", &inputs) == 2);
+    CHECK(vector_len(&inputs) == 2);
+    if (vector_len(&inputs) == 2) {
+        CHECK(strcmp(vector_get_str(&inputs, 0), "x.c") == 0);
+        CHECK(strcmp(vector_get_str(&inputs, 1), "y.h") == 0);
+    }
+    CHECK(!vector_contains(&inputs, "a.o"));
+    vector_free(&inputs);
+}
+
+// Moves a file's mtime `seconds` into the future, so edits are newer regardless of clock granularity
+static void touch_ahead(const char *path, int seconds) {
+    struct stat st;
+    if (stat(path, &st) != 0) return;
+    struct timespec times[2] = { st.st_atim, st.st_mtim };
+    times[1].tv_sec += seconds;
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+// ------ Restat ------
+
+static int build_filtered(void) {
+    SCmd *cmd = smb_cmd_create();
+    smb_cmd_append(cmd, "grep", "-v", "'^#'", "in.txt", ">", "out.txt", NULL);
+    smb_cmd_output(cmd, "out.txt");
+    smb_cmd_run_sync(cmd);
+    int dirty = cmd->dirty;
+    smb_cmd_free(cmd);
+    return dirty;
+}
+
+static void test_restat_unchanged_output(void) {
+    write_file("in.txt", "value\n");
+    Vector inputs;
+    vector_init_ops(&inputs, 1, sizeof(char *), &vector_ops_string_borrowed);
+    char *input = "in.txt";
+    vector_push(&inputs, &input);
+
+    CHECK(smb_needs_update("out.txt", &inputs));
+    CHECK(build_filtered() == 1);
+    CHECK(!smb_needs_update("out.txt", &inputs));
+
+    // A comment-only edit rebuilds once; the output keeps its old mtime and must then count as clean
+    write_file("in.txt", "# comment\nvalue\n");
+    touch_ahead("in.txt", 10);
+    CHECK(smb_needs_update("out.txt", &inputs));
+    CHECK(build_filtered() == 0);
+    CHECK(!smb_needs_update("out.txt", &inputs));
+
+    // A later real edit is still seen
+    write_file("in.txt", "other\n");
+    touch_ahead("in.txt", 20);
+    CHECK(smb_needs_update("out.txt", &inputs));
+    CHECK(build_filtered() == 1);
+    CHECK(!smb_needs_update("out.txt", &inputs));
+    vector_free(&inputs);
+}
+
+static bool same_file(const char *a, const char *b) {
+    size_t size_a, size_b;
+    char *data_a = smb_read_file(a, &size_a);
+    char *data_b = smb_read_file(b, &size_b);
+    bool same = data_a && data_b && size_a == size_b && memcmp(data_a, data_b, size_a) == 0;
+    free(data_a);
+    free(data_b);
+    return same;
+}
+
+// ------ Archive ------
+
+static void test_ar_matches_gnu_ar(void) {
+    if (system("ar --version >/dev/null 2>&1") != 0) return;
+    write_file("alpha.c", "int alpha(void) { return 1; }\nint shared_counter;\n");
+    write_file("a_rather_long_member_name.c", "static int hidden(void) { return 2; }\nint beta(void) { return hidden(); }\n");
+    CHECK(system("cc -c alpha.c a_rather_long_member_name.c") == 0);
+
+    Vector objects;
+    vector_init_ops(&objects, 2, sizeof(char *), &vector_ops_string_borrowed);
+    char *alpha = "alpha.o", *beta = "a_rather_long_member_name.o";
+    vector_push(&objects, &alpha);
+    vector_push(&objects, &beta);
+    CHECK(smb_ar_write("mine.a", &objects) == 1);
+    CHECK(system("ar rcsD gnu.a alpha.o a_rather_long_member_name.o") == 0);
+    CHECK(same_file("mine.a", "gnu.a"));
+
+    // Replacing a member with a different size rewrites the archive and its index
+    write_file("alpha.c", "int alpha(void) { return 3; }\nint gamma_value = 4;\n");
+    CHECK(system("cc -c alpha.c") == 0);
+    objects.size = 1;
+    CHECK(smb_ar_write("mine.a", &objects) == 1);
+    CHECK(system("ar rcsD gnu.a alpha.o") == 0);
+    CHECK(same_file("mine.a", "gnu.a"));
+
+    // A member cut off inside the ELF header contributes no symbols and is not read past its end
+    CHECK(system("head -c 56 alpha.o > truncated.o") == 0);
+    char *truncated = "truncated.o";
+    vector_push(&objects, &truncated);
+    CHECK(smb_ar_write("mine.a", &objects) == 1);
+    CHECK(system("ar rcsD gnu.a truncated.o 2>/dev/null") == 0);
+    CHECK(same_file("mine.a", "gnu.a"));
+    vector_free(&objects);
+}
+
+static void test_library_in_current_directory(void) {
+    write_file("libsmb_test_local.a", "!<arch>\n");
+    char *found = smb_find_library("smb_test_local");
+    CHECK(found && strcmp(found, "./libsmb_test_local.a") == 0);
+}
+
+int main(void) {
+    // Everything runs in a scratch directory so build state files do not leak into the tree
+    char dir[] = "/tmp/samba_test_XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) {
+        perror("scratch directory");
+        return 1;
+    }
+
+    test_depfile_multiple_targets();
+    test_restat_unchanged_output();
+    test_ar_matches_gnu_ar();
+    test_library_in_current_directory();
+
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) fprintf(stderr, "could not remove %s\n", dir);
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test_samba: ok\n");
+    return 0;
+}
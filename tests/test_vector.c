@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include "../vector.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+// ------ Contains ------
+
+static void test_contains_pargs(void) {
+    char *argv[] = { "./build", "-v", "--jobs", "4" };
+    Vector pargs = parse_pargs(4, argv);
+    CHECK(vector_contains(&pargs, "-v"));
+    CHECK(vector_contains(&pargs, "--jobs"));
+    CHECK(!vector_contains(&pargs, "-q"));
+    vector_free(&pargs);
+}
+
+static void test_contains_strings(void) {
+    Vector owned;
+    vector_init_ops(&owned, 2, sizeof(char *), &vector_ops_string);
+    char *a = strdup("alpha"), *b = strdup("beta");
+    vector_push(&owned, &a);
+    vector_push(&owned, &b);
+    char probe[] = "beta";
+    CHECK(vector_contains(&owned, probe));
+    CHECK(!vector_contains(&owned, "gamma"));
+    vector_free(&owned);
+
+    Vector ints;
+    vector_init(&ints, 4, sizeof(int));
+    for (int i = 0; i < 100; i++) vector_push(&ints, &i);
+    int hit = 77, miss = 100;
+    CHECK(vector_contains(&ints, &hit));
+    CHECK(!vector_contains(&ints, &miss));
+    vector_free(&ints);
+}
+
+// ------ Tokenizer ------
+
+static void test_tokenize_matches_strtok(void) {
+    static const char alphabet[] = "ab c\t\n:xyz  ";
+    char text[64], copy[64];
+    Vector tokens;
+    vector_init_ops(&tokens, 8, sizeof(Token), &vector_ops_plain);
+    srand(46);
+    for (int round = 0; round < 20000; round++) {
+        size_t len = (size_t)(rand() % 48);
+        for (size_t i = 0; i < len; i++) text[i] = alphabet[rand() % (int)(sizeof(alphabet) - 1)];
+        text[len] = '\0';
+        memcpy(copy, text, len + 1);
+
+        tokens.size = 0;
+        vector_tokenize(&tokens, text, len, " \t\n", TOKENIZE_PLAIN);
+        size_t n = 0;
+        char *save = NULL;
+        for (char *word = strtok_r(copy, " \t\n", &save); word; word = strtok_r(NULL, " \t\n", &save), n++) {
+            CHECK(n < tokens.size);
+            if (n >= tokens.size) break;
+            Token *token = (Token *)tokens.data + n;
+            CHECK(token->len == strlen(word) && memcmp(token->data, word, token->len) == 0);
+        }
+        CHECK(n == tokens.size);
+    }
+    vector_free(&tokens);
+}
+
+static void test_tokenize_depfile_targets(void) {
+    const char *text = "a.o b.o: x.c \\\n  y.h\nc.o : z.h\nd\\ e.o: C:\\src\\f.h\n";
+    Vector tokens;
+    vector_init_ops(&tokens, 8, sizeof(Token), &vector_ops_plain);
+    vector_tokenize(&tokens, text, strlen(text), " \t\r\n", TOKENIZE_DEPFILE);
+    const char *expected[] = { "a.o", "b.o", "x.c", "y.h", "c.o", "z.h", "d e.o", "C:\\src\\f.h" };
+    bool target[] = { true, true, false, false, true, false, true, false };
+    CHECK(tokens.size == 8);
+    for (size_t i = 0; i < tokens.size && i < 8; i++) {
+        char *word = token_dup((Token *)tokens.data + i, TOKENIZE_DEPFILE);
+        CHECK(strcmp(word, expected[i]) == 0);
+        CHECK(((((Token *)tokens.data)[i].flags & TOKEN_TARGET) != 0) == target[i]);
+        free(word);
+    }
+    vector_free(&tokens);
+}
+
+// ------ HashMap ------
+
+// Random puts and removes on both key kinds, checked against a plain array
+static void test_hashmap_random(void) {
+    enum { KEYS = 2048, OPS = 100000 };
+    static intptr_t expected[KEYS];
+    memset(expected, 0, sizeof(expected));
+    HashMap ints, strings;
+    hashmap_init(&ints, HASHMAP_INT);
+    hashmap_init(&strings, HASHMAP_STRING);
+    size_t live = 0;
+    char key[16];
+    srand(41);
+    for (int op = 0; op < OPS; op++) {
+        int k = rand() % KEYS;
+        snprintf(key, sizeof(key), "key-%d", k);
+        if (rand() % 3) {
+            intptr_t value = op + 1;
+            if (!expected[k]) live++;
+            expected[k] = value;
+            *hashmap_put_int(&ints, (uint64_t)k * 0x9e3779b97f4a7c15ull) = (void *)value;
+            *hashmap_put_str(&strings, key) = (void *)value;
+        } else {
+            void *removed = NULL;
+            bool had = expected[k] != 0;
+            CHECK(hashmap_remove_int(&ints, (uint64_t)k * 0x9e3779b97f4a7c15ull, &removed) == had);
+            CHECK(!had || (intptr_t)removed == expected[k]);
+            CHECK(hashmap_remove_str(&strings, key, NULL) == had);
+            if (had) live--;
+            expected[k] = 0;
+        }
+    }
+    CHECK(hashmap_len(&ints) == live && hashmap_len(&strings) == live);
+    for (int k = 0; k < KEYS; k++) {
+        snprintf(key, sizeof(key), "key-%d", k);
+        CHECK((intptr_t)hashmap_get_int(&ints, (uint64_t)k * 0x9e3779b97f4a7c15ull) == expected[k]);
+        CHECK((intptr_t)hashmap_get_str(&strings, key) == expected[k]);
+        CHECK(hashmap_contains_str(&strings, key) == (expected[k] != 0));
+    }
+    size_t seen = 0, it = 0;
+    for (HashMapEntry *entry; (entry = hashmap_next(&strings, &it)); seen++) {
+        CHECK((intptr_t)entry->value == expected[atoi(entry->key.str + 4)]);
+    }
+    CHECK(seen == live);
+
+    HashMap set = { 0 };
+    CHECK(hashset_add_str(&set, "a"));
+    CHECK(!hashset_add_str(&set, "a"));
+    hashmap_free(&set);
+    hashmap_free(&ints);
+    hashmap_free(&strings);
+}
+
+// ------ Sorting ------
+
+typedef struct {
+    int key;
+    int payload;
+} Pair;
+
+static int compare_pair(const void *a, const void *b) {
+    int x = ((const Pair *)a)->key, y = ((const Pair *)b)->key;
+    return (x > y) - (x < y);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Random, sorted, reversed and duplicate-heavy inputs, checked against qsort
+static void test_sort_random(void) {
+    static char names[64][8];
+    for (int i = 0; i < 64; i++) snprintf(names[i], sizeof(names[i]), "n%02d", i * 37 % 64);
+    srand(49);
+    for (int round = 0; round < 400; round++) {
+        size_t n = (size_t)(rand() % 2000);
+        int pattern = round % 4;
+        int range = pattern == 3 ? 8 : 1 << 30;
+
+        Vector ints, wide, strings, pairs;
+        vector_init(&ints, n + 1, sizeof(int));
+        vector_init_ops(&wide, n + 1, sizeof(uint64_t), &vector_ops_plain);
+        vector_init_ops(&strings, n + 1, sizeof(char *), &vector_ops_string_borrowed);
+        vector_init_ops(&pairs, n + 1, sizeof(Pair), &vector_ops_plain);
+        for (size_t i = 0; i < n; i++) {
+            int v = pattern == 1 ? (int)i : pattern == 2 ? (int)(n - i) : rand() % range - range / 2;
+            uint64_t w = ((uint64_t)rand() << 33) ^ (uint64_t)rand();
+            char *name = names[rand() % 64];
+            Pair pair = { v, (int)i };
+            vector_push(&ints, &v);
+            vector_push(&wide, &w);
+            vector_push(&strings, &name);
+            vector_push(&pairs, &pair);
+        }
+        int *ints_ref = malloc((n + 1) * sizeof(int));
+        uint64_t *wide_ref = malloc((n + 1) * sizeof(uint64_t));
+        char **strings_ref = malloc((n + 1) * sizeof(char *));
+        memcpy(ints_ref, ints.data, n * sizeof(int));
+        memcpy(wide_ref, wide.data, n * sizeof(uint64_t));
+        memcpy(strings_ref, strings.data, n * sizeof(char *));
+        qsort(ints_ref, n, sizeof(int), vector_compare_int);
+        qsort(wide_ref, n, sizeof(uint64_t), compare_u64);
+        qsort(strings_ref, n, sizeof(char *), compare_str);
+
+        vector_sort_ints(&ints, true);
+        vector_sort_ints(&wide, false);
+        if (round % 2) vector_sort_strings(&strings);
+        else vector_sort(&strings, NULL);
+        vector_sort(&pairs, compare_pair);
+
+        CHECK(memcmp(ints.data, ints_ref, n * sizeof(int)) == 0);
+        CHECK(memcmp(wide.data, wide_ref, n * sizeof(uint64_t)) == 0);
+        for (size_t i = 0; i < n; i++) CHECK(strcmp(((char **)strings.data)[i], strings_ref[i]) == 0);
+        for (size_t i = 0; i + 1 < n; i++) CHECK(compare_pair((Pair *)pairs.data + i, (Pair *)pairs.data + i + 1) <= 0);
+
+        if (n > 0) {
+            int probe = ints_ref[rand() % n];
+            size_t lower = vector_lower_bound(&ints, &probe, vector_compare_int);
+            CHECK(lower < n && ints_ref[lower] == probe && (lower == 0 || ints_ref[lower - 1] < probe));
+            ssize_t found = vector_bsearch(&ints, &probe, vector_compare_int);
+            CHECK(found >= 0 && ints_ref[found] == probe);
+        }
+        int missing = range;
+        CHECK(vector_bsearch(&ints, &missing, vector_compare_int) == -1);
+
+        free(ints_ref);
+        free(wide_ref);
+        free(strings_ref);
+        vector_free(&ints);
+        vector_free(&wide);
+        vector_free(&strings);
+        vector_free(&pairs);
+    }
+}
+
+// ------ Deque ------
+
+// 200k random operations on both ends, mirrored in a plain array that keeps the front at model[lo]
+static void test_deque_random(void) {
+    enum { OPS = 200000, SPAN = 2 * OPS + 16 };
+    int *model = malloc(SPAN * sizeof(int));
+    size_t lo = OPS + 8, hi = OPS + 8;
+    Deque deque;
+    deque_init(&deque, 0, sizeof(int));
+    int batch[8];
+    srand(50);
+    for (int op = 0; op < OPS; op++) {
+        int value = rand();
+        switch (rand() % 8) {
+        case 0: case 1:
+            deque_push_back(&deque, &value);
+            model[hi++] = value;
+            break;
+        case 2:
+            deque_push_front(&deque, &value);
+            model[--lo] = value;
+            break;
+        case 3: {
+            int out = -1;
+            bool had = lo < hi;
+            CHECK(deque_pop_front(&deque, &out) == had);
+            if (had) CHECK(out == model[lo++]);
+            break;
+        }
+        case 4: {
+            int out = -1;
+            bool had = lo < hi;
+            CHECK(deque_pop_back(&deque, &out) == had);
+            if (had) CHECK(out == model[--hi]);
+            break;
+        }
+        case 5:
+            for (int i = 0; i < 8; i++) batch[i] = value + i;
+            deque_push_back_many(&deque, batch, (size_t)(value % 8));
+            memcpy(model + hi, batch, (size_t)(value % 8) * sizeof(int));
+            hi += (size_t)(value % 8);
+            break;
+        case 6: {
+            size_t got = deque_pop_front_many(&deque, batch, (size_t)(value % 8));
+            CHECK(got == ((size_t)(value % 8) < hi - lo ? (size_t)(value % 8) : hi - lo));
+            CHECK(memcmp(batch, model + lo, got * sizeof(int)) == 0);
+            lo += got;
+            break;
+        }
+        default:
+            if (lo < hi) {
+                size_t index = (size_t)value % (hi - lo);
+                CHECK(*(int *)deque_get(&deque, index) == model[lo + index]);
+                CHECK(*(int *)deque_front(&deque) == model[lo] && *(int *)deque_back(&deque) == model[hi - 1]);
+            }
+            break;
+        }
+        CHECK(deque_len(&deque) == hi - lo);
+        // Recentre the model when one end runs out of room
+        if (lo < 16 || hi > SPAN - 16) {
+            size_t len = hi - lo;
+            memmove(model + (SPAN - len) / 2, model + lo, len * sizeof(int));
+            lo = (SPAN - len) / 2;
+            hi = lo + len;
+        }
+    }
+    size_t it = 0, i = lo;
+    for (int *value; (value = deque_next(&deque, &it)); i++) CHECK(*value == model[i]);
+    CHECK(i == hi);
+    deque_clear(&deque);
+    CHECK(deque_len(&deque) == 0 && !deque_pop_back(&deque, NULL));
+    deque_free(&deque);
+    free(model);
+}
+
+int main(void) {
+    test_contains_pargs();
+    test_contains_strings();
+    test_tokenize_matches_strtok();
+    test_tokenize_depfile_targets();
+    test_hashmap_random();
+    test_sort_random();
+    test_deque_random();
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("test_vector: ok\n");
+    return 0;
+}
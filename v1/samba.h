@@ -28,6 +28,14 @@
 #include <limits.h>
 #include <dlfcn.h>
 #include <curl/curl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <wordexp.h>
 
 
 // INFO | Macros | Each starts with S_
@@ -45,6 +53,9 @@
 // | S_REBUILD_NO_OUTPUT | Displays no out on rebuild   | -1
 // | S_CURLE | Enables using curl withing an easier interface | Disabled
 // | S_CURLE_SET | 1 IF S_CURLE ENABLED                 | 0
+// | S_PARTIAL_LINK_GROUP | Average objects per cached partial link | 64
+// | S_WORKER_PORT | Default port of compile workers      | 7070
+// | S_WORKER_TIMEOUT | Seconds before a silent worker is given up | 120
 
 // -- Macros --
 #define S_VERSION "1.1"
@@ -101,6 +112,7 @@ char *checkpoints_directory = "checkpoints/";
 #ifndef SAMBA_H
 #define SAMBA_H
 
+// Keys are interned (intern_string), values of variables are owned
 typedef struct {
     char *key;
     char *value;
@@ -156,6 +168,281 @@ void exit_error(const char *func, const char *fmt, ...) {
     exit(EXIT_FAILURE);
 }
 
+// -- Hashing --
+/*
+  @name hash_bytes
+  @parameters void *data, size_t len, unsigned long long seed
+  @description FNV-1a hash of the given bytes, chained through seed
+  @returns unsigned long long
+*/
+unsigned long long hash_bytes(const void *data, size_t len, unsigned long long seed) {
+    const unsigned char *p = (const unsigned char *)data;
+    unsigned long long h = seed ? seed : 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+  @name hash_file
+  @parameters char *path, unsigned long long *hash
+  @description Hashes the content of a file
+  @returns bool
+*/
+bool hash_file(const char *path, unsigned long long *hash) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    unsigned char buffer[65536];
+    unsigned long long h = 0;
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        h = hash_bytes(buffer, n, h);
+    }
+    fclose(file);
+    *hash = h ? h : hash_bytes("", 0, 0);
+    return true;
+}
+
+// -- File Helpers --
+static char *read_whole_file(const char *path, size_t *len) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *data = malloc(size > 0 ? size + 1 : 1);
+    if (data && size > 0 && fread(data, 1, size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    if (data) data[size > 0 ? size : 0] = '\0';
+    *len = size > 0 ? size : 0;
+    return data;
+}
+
+static bool write_whole_file(const char *path, const void *data, size_t len) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(data, 1, len, file) == len;
+    return fclose(file) == 0 && ok;
+}
+
+static void command_append(char **command, size_t *len, size_t *capacity, const char *fmt, ...) {
+    // Format straight into the spare capacity; only a result that does not fit is formatted twice
+    size_t spare = *capacity - *len;
+    va_list args;
+    va_start(args, fmt);
+    int needed = vsnprintf(spare ? *command + *len : NULL, spare, fmt, args);
+    va_end(args);
+    if (needed < 0) return;
+
+    if ((size_t)needed >= spare) {
+        size_t new_capacity = *capacity ? *capacity : 4096;
+        while (*len + needed + 1 > new_capacity) new_capacity *= 2;
+        char *temp = realloc(*command, new_capacity);
+        if (!temp) exit_error(__func__, "Out of memory");
+        *command = temp;
+        *capacity = new_capacity;
+
+        va_start(args, fmt);
+        vsnprintf(*command + *len, *capacity - *len, fmt, args);
+        va_end(args);
+    }
+    *len += needed;
+}
+
+// -- Tables --
+// String-keyed open-addressing table used for memoized lookups
+typedef struct {
+    char *key;
+    unsigned long long hash;
+    void *value;
+} table_entry_t;
+
+typedef struct {
+    table_entry_t *entries;
+    size_t size;
+    size_t capacity;
+} table_t;
+
+static table_entry_t *table_slot(table_entry_t *entries, size_t capacity, const char *key, unsigned long long hash) {
+    size_t i = (size_t)hash & (capacity - 1);
+    while (entries[i].key && (entries[i].hash != hash || strcmp(entries[i].key, key) != 0)) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &entries[i];
+}
+
+/*
+  @name table_get
+  @parameters table_t *table, char *key
+  @description Value stored under key, NULL if missing
+  @returns void *
+*/
+void *table_get(table_t *table, const char *key) {
+    if (table->size == 0) return NULL;
+    table_entry_t *entry = table_slot(table->entries, table->capacity, key, hash_bytes(key, strlen(key), 0));
+    return entry->key ? entry->value : NULL;
+}
+
+/*
+  @name table_put
+  @parameters table_t *table, char *key
+  @description Slot of the value stored under key, inserting the key if missing
+  @returns void **
+*/
+static void table_make_room(table_t *table) {
+    if ((table->size + 1) * 4 <= table->capacity * 3) return;
+    size_t capacity = table->capacity ? table->capacity * 2 : 32;
+    table_entry_t *entries = calloc(capacity, sizeof(table_entry_t));
+    if (!entries) exit_error(__func__, "Out of memory");
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->entries[i].key) {
+            *table_slot(entries, capacity, table->entries[i].key, table->entries[i].hash) = table->entries[i];
+        }
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+void **table_put(table_t *table, const char *key) {
+    table_make_room(table);
+
+    unsigned long long hash = hash_bytes(key, strlen(key), 0);
+    table_entry_t *entry = table_slot(table->entries, table->capacity, key, hash);
+    if (!entry->key) {
+        entry->key = strdup(key);
+        if (!entry->key) exit_error(__func__, "Out of memory");
+        entry->hash = hash;
+        entry->value = NULL;
+        table->size++;
+    }
+    return &entry->value;
+}
+
+/*
+  @name table_remove
+  @parameters table_t *table, char *key, bool free_value
+  @description Removes key if present | Later entries of the probe chain are shifted back, no tombstones
+  @returns bool
+*/
+bool table_remove(table_t *table, const char *key, bool free_value) {
+    if (table->size == 0) return false;
+    size_t mask = table->capacity - 1;
+    table_entry_t *entry = table_slot(table->entries, table->capacity, key, hash_bytes(key, strlen(key), 0));
+    if (!entry->key) return false;
+    free(entry->key);
+    if (free_value) free(entry->value);
+
+    size_t hole = (size_t)(entry - table->entries);
+    for (size_t i = (hole + 1) & mask; table->entries[i].key; i = (i + 1) & mask) {
+        size_t home = (size_t)table->entries[i].hash & mask;
+        // Move the entry back unless its home slot lies cyclically in (hole, i]
+        bool stays = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+        if (stays) continue;
+        table->entries[hole] = table->entries[i];
+        hole = i;
+    }
+    table->entries[hole].key = NULL;
+    table->entries[hole].value = NULL;
+    table->size--;
+    return true;
+}
+
+/*
+  @name table_clear
+  @parameters table_t *table, bool free_values
+  @description Removes all entries
+  @returns void
+*/
+void table_clear(table_t *table, bool free_values) {
+    for (size_t i = 0; i < table->capacity; i++) {
+        free(table->entries[i].key);
+        if (free_values) free(table->entries[i].value);
+    }
+    free(table->entries);
+    table->entries = NULL;
+    table->size = table->capacity = 0;
+}
+
+// -- Interning --
+// One canonical copy of every include path, flag and library name. The copies are packed into
+// large blocks and live until exit, so equal strings share a pointer and are never freed.
+typedef struct intern_block_t {
+    struct intern_block_t *next;
+    size_t used;
+    char data[];
+} intern_block_t;
+
+#define INTERN_BLOCK_SIZE (64 * 1024)
+
+static table_t interned = { 0 };           // keys point into intern blocks, values are unused
+static intern_block_t *intern_blocks = NULL;
+
+static intern_block_t *intern_new_block(intern_block_t *next) {
+    intern_block_t *block = malloc(sizeof(intern_block_t) + INTERN_BLOCK_SIZE);
+    if (!block) exit_error("intern_string", "Out of memory");
+    block->used = 0;
+    block->next = next;
+    return block;
+}
+
+/*
+  @name intern_lookup
+  @parameters char *str
+  @description Interned copy of str, NULL if it was never interned
+  @returns const char *
+*/
+const char *intern_lookup(const char *str) {
+    if (interned.size == 0) return NULL;
+    return table_slot(interned.entries, interned.capacity, str, hash_bytes(str, strlen(str), 0))->key;
+}
+
+/*
+  @name intern_string
+  @parameters char *str
+  @description Canonical copy of str | Equal strings always get the same pointer, do not free it
+  @returns const char *
+*/
+const char *intern_string(const char *str) {
+    size_t len = strlen(str);
+    unsigned long long hash = hash_bytes(str, len, 0);
+    table_make_room(&interned);
+    table_entry_t *entry = table_slot(interned.entries, interned.capacity, str, hash);
+    if (entry->key) return entry->key;
+
+    if (!intern_blocks || intern_blocks->used > INTERN_BLOCK_SIZE || INTERN_BLOCK_SIZE - intern_blocks->used < len + 1) {
+        if (len + 1 > INTERN_BLOCK_SIZE / 2) {
+            // An oversized string gets a block of its own behind the current one, the head is
+            // always a regular block so the space check above stays valid
+            if (!intern_blocks) intern_blocks = intern_new_block(NULL);
+            intern_block_t *own = malloc(sizeof(intern_block_t) + len + 1);
+            if (!own) exit_error(__func__, "Out of memory");
+            own->used = len + 1;
+            own->next = intern_blocks->next;
+            intern_blocks->next = own;
+            memcpy(own->data, str, len + 1);
+            entry->key = own->data;
+            entry->hash = hash;
+            interned.size++;
+            return entry->key;
+        }
+        intern_blocks = intern_new_block(intern_blocks);
+    }
+    char *copy = intern_blocks->data + intern_blocks->used;
+    memcpy(copy, str, len + 1);
+    intern_blocks->used += len + 1;
+    entry->key = copy;
+    entry->hash = hash;
+    interned.size++;
+    return copy;
+}
+
 /*
   @name escape_argument
   @parameters char *arg
@@ -177,6 +464,10 @@ char *escape_argument(const char *arg) {
     return escaped;
 }
 
+// Flag and library lookups go through these instead of scanning the arrays
+static table_t flag_index = { 0 };       // flag -> number of occurrences in flags
+static table_t library_index = { 0 };    // library -> number of occurrences in libraries
+
 /*
   @name define_variable
   @parameters char *var_name, char *var_value
@@ -186,8 +477,7 @@ char *escape_argument(const char *arg) {
 int define_variable(const char *var_name, const char *var_value) {
     variables = realloc(variables, sizeof(Entry) * (num_variables + 1));
     if (!variables) return S_ERROR;
-    variables[num_variables].key = strdup(var_name);
-    if (!variables[num_variables].key) return S_ERROR;
+    variables[num_variables].key = (char *)intern_string(var_name);
     variables[num_variables].value = strdup(var_value);
     if (!variables[num_variables].value) return S_ERROR;
     num_variables++;
@@ -197,16 +487,17 @@ int define_variable(const char *var_name, const char *var_value) {
 /*
   @name define_library
   @parameters char *library
-  @description Adds an Library to the build configuration
+  @description Adds an Library to the build configuration | Repeats are kept, link order matters (-la -lb -la)
   @returns int
 */
 int define_library(const char *library) {
     libraries = realloc(libraries, sizeof(Entry) * (num_libraries + 1));
     if (!libraries) return S_ERROR;
-    libraries[num_libraries].key = strdup(library);
-    if (!libraries[num_libraries].key) return S_ERROR;
+    libraries[num_libraries].key = (char *)intern_string(library);
     libraries[num_libraries].value = NULL;
     num_libraries++;
+    void **count = table_put(&library_index, library);
+    *count = (void *)((uintptr_t)*count + 1);
     return 0;
 }
 
@@ -219,8 +510,7 @@ int define_library(const char *library) {
 int define_include(const char *include_path) {
     includes = realloc(includes, sizeof(Entry) * (num_includes + 1));
     if (!includes) return S_ERROR;
-    includes[num_includes].key = strdup(include_path);
-    if (!includes[num_includes].key) return S_ERROR;
+    includes[num_includes].key = (char *)intern_string(include_path);
     includes[num_includes].value = NULL;
     num_includes++;
     return 0;
@@ -235,26 +525,58 @@ int define_include(const char *include_path) {
 int define_library_path(const char *path) {
     library_paths = realloc(library_paths, sizeof(Entry) * (num_library_paths + 1));
     if (!library_paths) return S_ERROR;
-    library_paths[num_library_paths].key = strdup(path);
-    if (!library_paths[num_library_paths].key) return S_ERROR;
+    library_paths[num_library_paths].key = (char *)intern_string(path);
     library_paths[num_library_paths].value = NULL;
     num_library_paths++;
     return 0;
 }
 
+// Flags whose value is the next argument (-Xlinker --foo, -include a.h); both may legitimately repeat
+static bool flag_takes_argument(const char *flag) {
+    const char *separate[] = { "-Xlinker", "-Xpreprocessor", "-Xassembler", "-include", "-imacros",
+                               "-isystem", "-idirafter", "-iquote", "-framework", "-x", "-arch", "-o" };
+    for (size_t i = 0; i < sizeof(separate) / sizeof(separate[0]); i++) {
+        if (strcmp(flag, separate[i]) == 0) return true;
+    }
+    return false;
+}
+
+// Flags that mean the same thing however often they appear; anything else (-Wl,-Bstatic, -l,
+// --whole-archive, ...) can depend on its position and is kept every time
+static bool flag_is_idempotent(const char *flag) {
+    if (flag[0] != '-' || flag[1] == '\0' || flag[2] == '\0') return false;
+    if (flag[1] == 'I' || flag[1] == 'D' || flag[1] == 'L') return true;
+    bool passthrough = flag[3] == ',' && (flag[2] == 'l' || flag[2] == 'a' || flag[2] == 'p');
+    return flag[1] == 'W' && !passthrough;
+}
+
+/*
+  @name has_flag
+  @parameters char *flag
+  @description Checks if flag is part of the build configuration
+  @returns bool
+*/
+bool has_flag(const char *flag) {
+    return table_get(&flag_index, flag) != NULL;
+}
+
 /*
   @name add_flag
   @parameters char *flag
-  @description Adds an flag to the build configuration
+  @description Adds an flag to the build configuration | A -I, -D, -L or warning flag that is already set is not added again
   @returns int
 */
 int add_flag(const char *flag) {
+    bool argument = num_flags > 0 && flag_takes_argument(flags[num_flags - 1]);
+    if (!argument && flag_is_idempotent(flag) && has_flag(flag)) return 0;
+
     char **temp = realloc(flags, sizeof(char *) * (num_flags + 1));
     if (!temp) return S_ERROR;
     flags = temp;
-    flags[num_flags] = strdup(flag);
-    if (!flags[num_flags]) return S_ERROR;
+    flags[num_flags] = (char *)intern_string(flag);
     num_flags++;
+    void **count = table_put(&flag_index, flag);
+    *count = (void *)((uintptr_t)*count + 1);
     return 0;
 }
 
@@ -265,9 +587,15 @@ int add_flag(const char *flag) {
   @returns int
 */
 int remove_flag(const char *flag) {
+    void **count = table_get(&flag_index, flag) ? table_put(&flag_index, flag) : NULL;
+    if (!count) return S_ERROR;
+
+    // The index answers misses; a hit still scans, since shifting the tail to keep the order is
+    // linear anyway and stored positions would have to be rewritten for every later flag
+    const char *canonical = intern_lookup(flag);
     int index = -1;
     for (int i = 0; i < num_flags; i++) {
-        if (strcmp(flags[i], flag) == 0) {
+        if (flags[i] == canonical) {
             index = i;
             break;
         }
@@ -275,14 +603,12 @@ int remove_flag(const char *flag) {
 
     if (index == -1) return S_ERROR;
 
-    free(flags[index]);
-
-    for (int i = index; i < num_flags - 1; i++) {
-        flags[i] = flags[i + 1];
-    }
-
+    memmove(&flags[index], &flags[index + 1], (num_flags - index - 1) * sizeof(char *));
     num_flags--;
 
+    *count = (void *)((uintptr_t)*count - 1);
+    if (!*count) table_remove(&flag_index, flag, false);
+
     char **temp = realloc(flags, sizeof(char *) * num_flags);
     if (!temp && num_flags > 0) return S_ERROR;
     flags = temp;
@@ -298,9 +624,13 @@ int remove_flag(const char *flag) {
   @returns void
 */
 void remove_library(const char *library) {
+    void **count = table_get(&library_index, library) ? table_put(&library_index, library) : NULL;
+    if (!count) return;
+    *count = (void *)((uintptr_t)*count - 1);
+    if (!*count) table_remove(&library_index, library, false);
+    const char *canonical = intern_lookup(library);
     for (size_t i = 0; i < num_libraries; i++) {
-        if (strcmp(libraries[i].key, library) == 0) {
-            free(libraries[i].key);
+        if (libraries[i].key == canonical) {
             libraries[i] = libraries[--num_libraries];
             return;
         }
@@ -314,9 +644,10 @@ void remove_library(const char *library) {
   @returns void
 */
 void remove_include(const char *include_path) {
+    const char *canonical = intern_lookup(include_path);
+    if (!canonical) return;
     for (size_t i = 0; i < num_includes; i++) {
-        if (strcmp(includes[i].key, include_path) == 0) {
-            free(includes[i].key);
+        if (includes[i].key == canonical) {
             includes[i] = includes[--num_includes];
             return;
         }
@@ -330,9 +661,10 @@ void remove_include(const char *include_path) {
   @returns void
 */
 void remove_library_path(const char *path) {
+    const char *canonical = intern_lookup(path);
+    if (!canonical) return;
     for (size_t i = 0; i < num_library_paths; i++) {
-        if (strcmp(library_paths[i].key, path) == 0) {
-            free(library_paths[i].key);
+        if (library_paths[i].key == canonical) {
             library_paths[i] = library_paths[--num_library_paths];
             return;
         }
@@ -347,9 +679,10 @@ void remove_library_path(const char *path) {
   @returns int
 */
 int remove_variable(const char *var_name) {
+    const char *canonical = intern_lookup(var_name);
     int index = -1;
-    for (int i = 0; i < num_variables; i++) {
-        if (strcmp(variables[i].key, var_name) == 0) {
+    for (int i = 0; canonical && i < num_variables; i++) {
+        if (variables[i].key == canonical) {
             index = i;
             break;
         }
@@ -357,7 +690,6 @@ int remove_variable(const char *var_name) {
 
     if (index == -1) return S_ERROR;
 
-    free(variables[index].key);
     free(variables[index].value);
 
     for (int i = index; i < num_variables - 1; i++) {
@@ -383,6 +715,94 @@ static bool build_directory_exists(const char *path) {
      return (stat(path, &info) == 0 && (info.st_mode & S_IFDIR));
 }
 
+// -- Tool Lookup --
+static table_t tool_paths = { 0 };
+static char *tool_paths_env = NULL;
+static pthread_mutex_t tool_paths_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *search_path(const char *tool) {
+    struct stat info;
+    if (strchr(tool, '/')) {
+        if (access(tool, X_OK) == 0 && stat(tool, &info) == 0 && S_ISREG(info.st_mode)) return realpath(tool, NULL);
+        return NULL;
+    }
+
+    const char *path = getenv("PATH");
+    if (!path) return NULL;
+
+    char candidate[PATH_MAX];
+    const char *dir = path;
+    for (;;) {
+        const char *end = strchr(dir, ':');
+        size_t len = end ? (size_t)(end - dir) : strlen(dir);
+        // An empty PATH entry means the current directory
+        if (len == 0) snprintf(candidate, sizeof(candidate), "./%s", tool);
+        else snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)len, dir, tool);
+
+        if (access(candidate, X_OK) == 0 && stat(candidate, &info) == 0 && S_ISREG(info.st_mode)) {
+            return candidate[0] == '/' ? strdup(candidate) : realpath(candidate, NULL);
+        }
+        if (!end) break;
+        dir = end + 1;
+    }
+    return NULL;
+}
+
+/*
+  @name which_tool
+  @parameters char *tool
+  @description Resolves tool to an absolute path by scanning PATH in-process | Results are memoized until PATH changes
+  @returns char * | NULL if not found, do not free
+*/
+const char *which_tool(const char *tool) {
+    pthread_mutex_lock(&tool_paths_mutex);
+
+    const char *path = getenv("PATH");
+    if (!tool_paths_env || !path || strcmp(tool_paths_env, path) != 0) {
+        table_clear(&tool_paths, true);
+        free(tool_paths_env);
+        tool_paths_env = strdup(path ? path : "");
+    }
+
+    void **slot = table_put(&tool_paths, tool);
+    if (!*slot) {
+        char *found = search_path(tool);
+        *slot = found ? found : strdup("");
+    }
+    const char *result = *(char **)slot;
+
+    pthread_mutex_unlock(&tool_paths_mutex);
+    return result[0] ? result : NULL;
+}
+
+static char resolved_compiler[PATH_MAX * 2];
+static pthread_once_t resolved_compiler_once = PTHREAD_ONCE_INIT;
+
+static void resolve_compiler() {
+    char words[] = S_COMPILER;
+    char *save = NULL;
+    size_t len = 0;
+    for (char *word = strtok_r(words, " ", &save); word; word = strtok_r(NULL, " ", &save)) {
+        const char *path = which_tool(word);
+        len += snprintf(resolved_compiler + len, sizeof(resolved_compiler) - len, "%s%s", len ? " " : "", path ? path : word);
+        if (len >= sizeof(resolved_compiler)) {
+            resolved_compiler[0] = '\0';
+            return;
+        }
+    }
+}
+
+/*
+  @name compiler_command
+  @parameters void
+  @description S_COMPILER with every word resolved to an absolute path, so spawns skip the PATH search
+  @returns char *
+*/
+const char *compiler_command() {
+    pthread_once(&resolved_compiler_once, resolve_compiler);
+    return resolved_compiler[0] ? resolved_compiler : S_COMPILER;
+}
+
 /*
   @name check_tool
   @parameters char *tool
@@ -390,159 +810,1463 @@ static bool build_directory_exists(const char *path) {
   @returns bool
 */
 bool check_tool(const char *tool) {
-    char command[256];
-    snprintf(command, sizeof(command), "which %s > /dev/null 2>&1", tool);
-    return (system(command) == 0);
+    return which_tool(tool) != NULL;
 }
 
 /*
-  @name compile
-  @parameters char *script_file, char *output_file, bool create_shared
-  @description Compiles a script file into an executable file with all given configuration.
-  @returns void
+  @name make_directories
+  @parameters char *path
+  @description PRIVATE FUNCTION | mkdir -p
+  @returns bool
 */
-void compile(const char *script_file, const char *output_file, bool create_shared) {
-    #ifdef S_CACHE_COMPILATION
-        if (!check_tool("ccache")) {
-            if (check_tool("dnf")) {
-                system("sudo dnf install ccache -y");
-                system("clear");
-            }
-            else if (check_tool("apt-get")) {
-                system("sudo apt-get install ccache");
-                system("clear");
-            }
-            else {
-                printf("ccache not found. Please install ccache.\n");
-                return;
-            }
+static bool make_directories(const char *path) {
+    char buffer[PATH_MAX];
+    snprintf(buffer, sizeof(buffer), "%s", path);
+    for (char *p = buffer + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(buffer, 0755);
+            *p = '/';
         }
-    #endif
-    char command[4096];
-    snprintf(command, sizeof(command), "%s ", S_COMPILER);
-
-    for (size_t i = 0; i < num_variables; i++) {
-            snprintf(command + strlen(command), sizeof(command) - strlen(command), "-D%s='\"%s\"' ", variables[i].key, variables[i].value);
-    }
-    for (size_t i = 0; i < num_includes; i++) {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "-I%s ", includes[i].key);
-    }
-    for (size_t i = 0; i < num_library_paths; i++) {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "-L%s ", library_paths[i].key);
-    }
-    for (size_t i = 0; i < num_libraries; i++) {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "-l%s ", libraries[i].key);
     }
-    for (size_t i = 0; i < num_flags; i++) {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "%s ", flags[i]);
-    }
-    if (create_shared) {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "-shared ");
-    }
-    if (build_directory == NULL) {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "-o %s %s", output_file, script_file);
+    return mkdir(buffer, 0755) == 0 || build_directory_exists(buffer);
+}
+
+// -- Probe Cache --
+// Configure probe results are kept in <build>/config.cache, one entry per probe:
+//   "<probe>\t<key>\t<found>\t<value>\t<input count>\n" then "<mtime> <size> <path>\n" per input file.
+// An entry is reused while its key (PATH, compiler, search directories, ...) is the same and none of
+// its input files changed. The file is append-only; later entries win and it is compacted on load.
+typedef struct {
+    unsigned long long key;
+    bool found;
+    bool checked;        // inputs already compared against the disk in this run
+    char *value;
+    char *inputs;
+} probe_entry_t;
+
+static table_t probe_entries = { 0 };
+static bool probe_entries_loaded = false;
+static pthread_mutex_t probe_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *probe_cache_path() {
+    static char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/config.cache", build_directory ? build_directory : ".");
+    return path;
+}
+
+static void probe_entry_free(probe_entry_t *entry) {
+    if (!entry) return;
+    free(entry->value);
+    free(entry->inputs);
+    free(entry);
+}
+
+static void probe_entry_write(FILE *file, const char *probe, probe_entry_t *entry) {
+    int input_count = 0;
+    for (const char *p = entry->inputs; *p; p++) input_count += *p == '\n';
+    fprintf(file, "%s\t%016llx\t%d\t%s\t%d\n%s", probe, entry->key, entry->found, entry->value, input_count, entry->inputs);
+}
+
+static void probe_cache_load() {
+    probe_entries_loaded = true;
+    size_t size;
+    char *text = read_whole_file(probe_cache_path(), &size);
+    if (!text) return;
+
+    size_t lines = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        char *fields[5];
+        int n = 0;
+        for (char *p = line; n < 5; ) {
+            fields[n++] = p;
+            p = strchr(p, '\t');
+            if (!p) break;
+            *p++ = '\0';
+        }
+        if (n < 5) continue;
+
+        probe_entry_t *entry = calloc(1, sizeof(probe_entry_t));
+        if (!entry) exit_error(__func__, "Out of memory");
+        entry->key = strtoull(fields[1], NULL, 16);
+        entry->found = fields[2][0] == '1';
+        entry->value = strdup(fields[3]);
+
+        size_t len = 0, capacity = 0;
+        command_append(&entry->inputs, &len, &capacity, "%s", "");
+        for (int i = atoi(fields[4]); i > 0; i--) {
+            char *input = strtok_r(NULL, "\n", &save);
+            if (!input) break;
+            command_append(&entry->inputs, &len, &capacity, "%s\n", input);
+        }
+
+        void **slot = table_put(&probe_entries, fields[0]);
+        probe_entry_free(*slot);
+        *slot = entry;
+        lines++;
     }
-    else {
-        snprintf(command + strlen(command), sizeof(command) - strlen(command), "-o %s/%s %s", build_directory, output_file, script_file);
-        if (!build_directory_exists(build_directory)) {
-            if (verbose_mode) {
-            printf("Build directory '%s' does not exist. Creating it...\n", build_directory);
-            }
-            if (mkdir(build_directory, 0755) != 0) {
-                exit_error(__func__, "Failed to create build directory");
-            }
-            verbose_log("Build directory created successfully.\n");
+    free(text);
+
+    // Rewrite once superseded entries outnumber the live ones
+    if (lines > 2 * probe_entries.size) {
+        char temp[PATH_MAX + 8];
+        snprintf(temp, sizeof(temp), "%s.tmp", probe_cache_path());
+        FILE *file = fopen(temp, "w");
+        if (!file) return;
+        for (size_t i = 0; i < probe_entries.capacity; i++) {
+            if (probe_entries.entries[i].key) probe_entry_write(file, probe_entries.entries[i].key, probe_entries.entries[i].value);
         }
+        if (fclose(file) == 0) rename(temp, probe_cache_path());
+        else remove(temp);
     }
+}
 
-
-    verbose_log("Executing command: %s\n", command);
-    if (system(command) != 0) {
-        fprintf(stderr, "Error: Compilation failed.\n");
-    } else {
-        printf("Compilation successful: %s\n", output_file);
+static bool probe_inputs_unchanged(const char *inputs) {
+    char *copy = strdup(inputs);
+    char *save = NULL;
+    bool unchanged = true;
+    for (char *line = strtok_r(copy, "\n", &save); line && unchanged; line = strtok_r(NULL, "\n", &save)) {
+        long long mtime, size;
+        int offset = 0;
+        struct stat info;
+        unchanged = sscanf(line, "%lld %lld %n", &mtime, &size, &offset) == 2 && offset > 0 &&
+                    stat(line + offset, &info) == 0 &&
+                    (long long)info.st_mtime == mtime && (long long)info.st_size == size;
     }
+    free(copy);
+    return unchanged;
 }
 
 /*
-  @name free_all
-  @parameters void
-  @description Frees All
+  @name probe_input
+  @parameters char **inputs, size_t *len, size_t *capacity, char *path
+  @description Adds a file, with its current mtime and size, to the inputs of a probe
   @returns void
 */
-void free_all() {
-    for (size_t i = 0; i < num_libraries; i++) free(libraries[i].key);
-    free(libraries);
-    for (size_t i = 0; i < num_includes; i++) free(includes[i].key);
-    free(includes);
-    for (size_t i = 0; i < num_library_paths; i++) free(library_paths[i].key);
-    free(library_paths);
-    for (size_t i = 0; i < num_flags; i++) free(flags[i]);
-    free(flags);
-    libraries = includes = library_paths = NULL;
-    flags = NULL;
-    num_libraries = num_includes = num_library_paths = num_flags = 0;
+void probe_input(char **inputs, size_t *len, size_t *capacity, const char *path) {
+    struct stat info;
+    if (stat(path, &info) != 0) return;
+    command_append(inputs, len, capacity, "%lld %lld %s\n", (long long)info.st_mtime, (long long)info.st_size, path);
 }
 
 /*
-  @name reset_settings
-  @parameters void
-  @description Frees All | Is made if your wanna make 2 targets or more with different flags
-  @returns void
+  @name probe_cache_get
+  @parameters char *probe, unsigned long long key, bool *found, char **value
+  @description Looks up a cached probe result | value stays valid until the probe is stored again
+  @returns bool | false if there is no entry or it was invalidated
 */
-void reset_settings() {
-    free_all();
-    #undef verbose_mode
-    #define verbose_mode false
+bool probe_cache_get(const char *probe, unsigned long long key, bool *found, const char **value) {
+    pthread_mutex_lock(&probe_mutex);
+    if (!probe_entries_loaded) probe_cache_load();
+
+    probe_entry_t *entry = table_get(&probe_entries, probe);
+    bool hit = entry && entry->key == key;
+    if (hit && !entry->checked) {
+        hit = probe_inputs_unchanged(entry->inputs);
+        entry->checked = hit;
+    }
+    if (hit) {
+        if (found) *found = entry->found;
+        if (value) *value = entry->value;
+    }
+    pthread_mutex_unlock(&probe_mutex);
+    return hit;
 }
 
 /*
-  @name needs_rebuild
-  @parameters char *source_file, char *executable
-  @description Used in SAMBA_GO_REBUILD_URSELF | you can also use it
-  @returns int
+  @name probe_cache_put
+  @parameters char *probe, unsigned long long key, bool found, char *value, char *inputs
+  @description Records a probe result | value must not contain tabs or newlines, inputs come from probe_input (may be NULL)
+  @returns char * | the stored value
 */
-int needs_rebuild(const char *source_file, const char *executable) {
-    struct stat source_stat, exe_stat;
-
-    if (stat(source_file, &source_stat) != 0) {
-        fprintf(stderr, "Error: Source file '%s' not found.\n", source_file);
-        return 1;
+const char *probe_cache_put(const char *probe, unsigned long long key, bool found, const char *value, const char *inputs) {
+    probe_entry_t *entry = calloc(1, sizeof(probe_entry_t));
+    if (!entry) exit_error(__func__, "Out of memory");
+    entry->key = key;
+    entry->found = found;
+    entry->checked = true;
+    entry->value = strdup(value ? value : "");
+    entry->inputs = strdup(inputs ? inputs : "");
+
+    pthread_mutex_lock(&probe_mutex);
+    if (!probe_entries_loaded) probe_cache_load();
+
+    void **slot = table_put(&probe_entries, probe);
+    probe_entry_free(*slot);
+    *slot = entry;
+
+    if (build_directory && !build_directory_exists(build_directory)) mkdir(build_directory, 0755);
+    FILE *file = fopen(probe_cache_path(), "a");
+    if (file) {
+        probe_entry_write(file, probe, entry);
+        fclose(file);
     }
+    pthread_mutex_unlock(&probe_mutex);
+    return entry->value;
+}
 
-    if (stat(executable, &exe_stat) != 0) {
-        fprintf(stderr, "Warning: Executable '%s' not found.\n", executable);
-        return 1;
+// -- Compiler Fingerprint --
+// Identity of the compiler S_COMPILER resolves to: version, target and a hash of its builtin include
+// directories and predefined macros. Computed once per compiler binary and kept in the probe cache,
+// keyed by the inode, mtime and size of every binary in the compiler command.
+typedef struct {
+    char path[PATH_MAX];          // resolved compiler command
+    char version[64];             // -dumpfullversion (-dumpversion for compilers without it)
+    char machine[128];            // -dumpmachine
+    unsigned long long builtins;  // builtin include directories and predefined macros
+    unsigned long long hash;      // version, machine and builtins; independent of the install path
+} compiler_fingerprint_t;
+
+static compiler_fingerprint_t fingerprint = { 0 };
+static pthread_once_t fingerprint_once = PTHREAD_ONCE_INIT;
+
+// stdout and stderr of command, NULL if it could not be run
+static char *capture_command(const char *command) {
+    char *full = NULL;
+    size_t full_len = 0, full_capacity = 0;
+    command_append(&full, &full_len, &full_capacity, "%s 2>&1", command);
+    FILE *pipe = popen(full, "r");
+    free(full);
+    if (!pipe) return NULL;
+
+    char *output = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&output, &len, &capacity, "%s", "");
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer) - 1, pipe)) > 0) {
+        buffer[n] = '\0';
+        command_append(&output, &len, &capacity, "%s", buffer);
+    }
+    if (pclose(pipe) != 0) {
+        free(output);
+        return NULL;
     }
+    return output;
+}
 
-    if (source_stat.st_mtime > exe_stat.st_mtime) {
-        #ifndef S_REBUILD_NO_OUTPUT
-            verbose_log("Source file '%s' is newer than executable '%s'. Rebuild required.\n", source_file, executable);
-        #endif
+static void capture_first_line(const char *command, char *out, size_t size) {
+    char *output = capture_command(command);
+    snprintf(out, size, "%.*s", output ? (int)strcspn(output, "\r\n") : 0, output ? output : "");
+    free(output);
+}
 
-        return 1;
+// The binaries behind the compiler command; a reinstall or upgrade changes one of them
+static unsigned long long fingerprint_key(const char *command) {
+    unsigned long long key = hash_bytes(command, strlen(command) + 1, 0);
+    char words[PATH_MAX * 2];
+    snprintf(words, sizeof(words), "%s", command);
+    char *save = NULL;
+    for (char *word = strtok_r(words, " ", &save); word; word = strtok_r(NULL, " ", &save)) {
+        struct stat info;
+        if (word[0] != '/' || stat(word, &info) != 0) continue;
+        long long fields[4] = { (long long)info.st_dev, (long long)info.st_ino, (long long)info.st_mtime, (long long)info.st_size };
+        key = hash_bytes(fields, sizeof(fields), key);
     }
+    return key;
+}
 
-    #ifndef S_REBUILD_NO_OUTPUT
-        verbose_log("Executable '%s' is up-to-date. Running...\n", executable);
-    #endif
-    return 0;
+static void compute_fingerprint() {
+    const char *command = compiler_command();
+    snprintf(fingerprint.path, sizeof(fingerprint.path), "%s", command);
+
+    char probe[PATH_MAX * 2 + 16];
+    snprintf(probe, sizeof(probe), "compiler:%s", command);
+    unsigned long long key = fingerprint_key(command);
+
+    const char *value;
+    unsigned long long builtins;
+    int offset = 0;
+    if (probe_cache_get(probe, key, NULL, &value) &&
+        sscanf(value, "%llx,%127[^,],%n", &builtins, fingerprint.machine, &offset) == 2 && offset > 0) {
+        fingerprint.builtins = builtins;
+        snprintf(fingerprint.version, sizeof(fingerprint.version), "%s", value + offset);
+    } else {
+        char *line = NULL;
+        size_t len = 0, capacity = 0;
+        command_append(&line, &len, &capacity, "%s -dumpfullversion", command);
+        capture_first_line(line, fingerprint.version, sizeof(fingerprint.version));
+        if (!fingerprint.version[0]) {
+            len = 0;
+            command_append(&line, &len, &capacity, "%s -dumpversion", command);
+            capture_first_line(line, fingerprint.version, sizeof(fingerprint.version));
+        }
+        len = 0;
+        command_append(&line, &len, &capacity, "%s -dumpmachine", command);
+        capture_first_line(line, fingerprint.machine, sizeof(fingerprint.machine));
+
+        // Only the search list and the macros count; the rest of -v output names temporary files
+        len = 0;
+        command_append(&line, &len, &capacity, "%s -x c -E -dM -v /dev/null", command);
+        char *output = capture_command(line);
+        free(line);
+        builtins = hash_bytes("builtins", 8, 0);
+        bool search_list = false;
+        char *save = NULL;
+        for (char *row = output ? strtok_r(output, "\n", &save) : NULL; row; row = strtok_r(NULL, "\n", &save)) {
+            if (strncmp(row, "#include ", 9) == 0 && strstr(row, "search starts here")) search_list = true;
+            else if (strncmp(row, "End of search list", 18) == 0) search_list = false;
+            else if (strncmp(row, "#define ", 8) == 0 || (search_list && row[0] == ' ')) builtins = hash_bytes(row, strlen(row) + 1, builtins);
+        }
+        free(output);
+        fingerprint.builtins = builtins;
+
+        for (char *p = fingerprint.machine; *p; p++) if (*p == ',' || *p == '\t') *p = '_';
+        for (char *p = fingerprint.version; *p; p++) if (*p == '\t') *p = ' ';
+        char cached[256];
+        snprintf(cached, sizeof(cached), "%016llx,%s,%s", fingerprint.builtins, fingerprint.machine, fingerprint.version);
+        probe_cache_put(probe, key, true, cached, NULL);
+    }
+
+    unsigned long long hash = hash_bytes(fingerprint.version, strlen(fingerprint.version) + 1, 0);
+    hash = hash_bytes(fingerprint.machine, strlen(fingerprint.machine) + 1, hash);
+    fingerprint.hash = hash_bytes(&fingerprint.builtins, sizeof(fingerprint.builtins), hash);
+    verbose_log("Compiler: %s %s (%s) builtins=%016llx\n", fingerprint.path, fingerprint.version, fingerprint.machine, fingerprint.builtins);
 }
 
 /*
-  @name file_exists
-  @parameters char *path
-  @description Checks if the given file exists
-  @returns bool
+  @name compiler_fingerprint
+  @parameters void
+  @description Version, target and builtin-header hash of the compiler | Computed once per compiler binary and cached on disk
+  @returns compiler_fingerprint_t *
 */
-bool file_exists(const char *path) {
-    struct stat buffer;
-    return (stat(path, &buffer) == 0);
+const compiler_fingerprint_t *compiler_fingerprint() {
+    pthread_once(&fingerprint_once, compute_fingerprint);
+    return &fingerprint;
 }
 
 /*
-  @name SAMBA_GO_REBUILD_URSELF
-  @parameters void
+  @name probe_key
+  @parameters bool compiler
+  @description Fingerprint of the probe environment: PATH and, if compiler is set, the compiler command and fingerprint
+  @returns unsigned long long
+*/
+unsigned long long probe_key(bool compiler) {
+    const char *path = getenv("PATH");
+    unsigned long long key = hash_bytes(path ? path : "", path ? strlen(path) : 0, 0);
+    if (!compiler) return key;
+
+    const char *command = compiler_command();
+    key = hash_bytes(command, strlen(command) + 1, key);
+    return hash_bytes(&compiler_fingerprint()->hash, sizeof(unsigned long long), key);
+}
+
+// -- Toolchain --
+// Capabilities of the compiler/linker pair, probed once and kept in the probe cache.
+typedef struct {
+    bool probed;
+    char linker[16];     // value for -fuse-ld, empty for the compiler default
+    bool split_dwarf;    // compiler accepts -gsplit-dwarf
+    bool gdb_index;      // linker accepts --gdb-index
+} toolchain_t;
+
+toolchain_t toolchain = { 0 };
+
+static bool toolchain_try(const char *extra_flags, bool link) {
+    char object[PATH_MAX];
+    char command[PATH_MAX * 2];
+    snprintf(object, sizeof(object), "%s/.samba_probe", build_directory ? build_directory : ".");
+    snprintf(command, sizeof(command), "echo 'int main(void){return 0;}' | %s -x c - %s %s -o %s > /dev/null 2>&1",
+             compiler_command(), link ? "" : "-c", extra_flags, object);
+    int result = system(command);
+    remove(object);
+    // -gsplit-dwarf leaves the debug info beside the object
+    snprintf(command, sizeof(command), "%s.dwo", object);
+    remove(command);
+    return result == 0;
+}
+
+// Probe results stay valid while PATH and the compiler are the same
+static bool toolchain_load() {
+    const char *value;
+    if (!probe_cache_get("toolchain", probe_key(true), NULL, &value)) return false;
+
+    int split_dwarf = 0, gdb_index = 0;
+    const char *comma = strchr(value, ',');
+    if (!comma || sscanf(comma, ",%d,%d", &split_dwarf, &gdb_index) != 2) return false;
+    snprintf(toolchain.linker, sizeof(toolchain.linker), "%.*s", (int)(comma - value), value);
+    toolchain.split_dwarf = split_dwarf;
+    toolchain.gdb_index = gdb_index;
+    return true;
+}
+
+/*
+  @name probe_toolchain
+  @parameters void
+  @description Detects a fast linker (mold, ld.lld) and split DWARF support | Result is cached per compiler and PATH
+  @returns toolchain_t *
+*/
+toolchain_t *probe_toolchain() {
+    if (toolchain.probed) return &toolchain;
+
+    if (build_directory && !build_directory_exists(build_directory)) {
+        mkdir(build_directory, 0755);
+    }
+    if (toolchain_load()) {
+        toolchain.probed = true;
+        verbose_log("Toolchain (cached): linker=%s split_dwarf=%d gdb_index=%d\n",
+                    toolchain.linker[0] ? toolchain.linker : "default", toolchain.split_dwarf, toolchain.gdb_index);
+        return &toolchain;
+    }
+    toolchain.probed = true;
+
+    const char *linkers[][2] = { { "mold", "mold" }, { "ld.lld", "lld" } };
+    for (size_t i = 0; i < sizeof(linkers) / sizeof(linkers[0]); i++) {
+        char flag[32];
+        snprintf(flag, sizeof(flag), "-fuse-ld=%s", linkers[i][1]);
+        if (check_tool(linkers[i][0]) && toolchain_try(flag, true)) {
+            snprintf(toolchain.linker, sizeof(toolchain.linker), "%s", linkers[i][1]);
+            break;
+        }
+    }
+
+    // GNU ld (bfd) has no --gdb-index, so only ask for it with a fast linker
+    toolchain.split_dwarf = toolchain_try("-g -gsplit-dwarf", false);
+    if (toolchain.linker[0]) {
+        char flag[64];
+        snprintf(flag, sizeof(flag), "-fuse-ld=%s -Wl,--gdb-index", toolchain.linker);
+        toolchain.gdb_index = toolchain_try(flag, true);
+    }
+
+    char value[64];
+    snprintf(value, sizeof(value), "%s,%d,%d", toolchain.linker, toolchain.split_dwarf, toolchain.gdb_index);
+    probe_cache_put("toolchain", probe_key(true), true, value, NULL);
+
+    verbose_log("Toolchain: linker=%s split_dwarf=%d gdb_index=%d\n",
+                toolchain.linker[0] ? toolchain.linker : "default", toolchain.split_dwarf, toolchain.gdb_index);
+    return &toolchain;
+}
+
+/*
+  @name toolchain_link_flags
+  @parameters void
+  @description Linker flags selected by probe_toolchain (empty if nothing was probed)
+  @returns char *
+*/
+const char *toolchain_link_flags() {
+    static char link_flags[64];
+    link_flags[0] = '\0';
+    if (!toolchain.probed) return link_flags;
+
+    if (toolchain.linker[0]) {
+        snprintf(link_flags, sizeof(link_flags), "-fuse-ld=%s ", toolchain.linker);
+    }
+    #ifdef S_DEBUG_MODE
+        if (toolchain.gdb_index) {
+            strncat(link_flags, "-Wl,--gdb-index ", sizeof(link_flags) - strlen(link_flags) - 1);
+        }
+    #endif
+    return link_flags;
+}
+
+// -- Distributed Compilation --
+// A worker (`samba --worker [port]`) accepts preprocessed sources and returns objects.
+// Request:  "SAMBA-JOB 1\n" <argc>\n then <len>\n<arg> per argument, then <len>\n<preprocessed source>
+// Response: "SAMBA-OK <status> <stderr_len> <object_len>\n" <stderr> <object>, "SAMBA-BUSY\n" or
+// "SAMBA-REJECT\n"
+// Workers listen on 127.0.0.1 unless another address is chosen with set_worker_address. They only run
+// their own S_COMPILER, without a shell, and reject options that load or run other programs; this
+// is no sandbox, so only expose a worker to hosts you trust.
+#ifndef S_WORKER_PORT
+    #define S_WORKER_PORT 7070
+#endif
+#ifndef S_WORKER_TIMEOUT
+    #define S_WORKER_TIMEOUT 120
+#endif
+
+char **workers = NULL;
+size_t num_workers = 0;
+static unsigned int next_worker = 0;
+static char *worker_address = NULL;
+
+/*
+  @name set_worker_address
+  @parameters char *address
+  @description Sets the IPv4 address run_worker listens on (default 127.0.0.1) | "0.0.0.0" accepts jobs from every host
+  @returns void
+*/
+void set_worker_address(const char *address) {
+    free(worker_address);
+    worker_address = address ? strdup(address) : NULL;
+}
+
+/*
+  @name add_worker
+  @parameters char *address
+  @description Adds a compile worker ("host:port" or "host") used by compile()
+  @returns int
+*/
+int add_worker(const char *address) {
+    char **temp = realloc(workers, sizeof(char *) * (num_workers + 1));
+    if (!temp) return S_ERROR;
+    workers = temp;
+    workers[num_workers] = strdup(address);
+    if (!workers[num_workers]) return S_ERROR;
+    num_workers++;
+    return 0;
+}
+
+static void set_socket_timeout(int fd, int seconds) {
+    struct timeval timeout = { .tv_sec = seconds, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const char *p = (const char *)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t len) {
+    char *p = (char *)data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool read_line(int fd, char *line, size_t size) {
+    size_t len = 0;
+    while (len + 1 < size) {
+        if (read(fd, line + len, 1) != 1) return false;
+        if (line[len] == '\n') break;
+        len++;
+    }
+    line[len] = '\0';
+    return true;
+}
+
+static bool write_blob(int fd, const void *data, size_t len) {
+    char header[32];
+    int n = snprintf(header, sizeof(header), "%zu\n", len);
+    return write_all(fd, header, n) && write_all(fd, data, len);
+}
+
+static char *read_blob(int fd, size_t *len) {
+    char header[32];
+    if (!read_line(fd, header, sizeof(header))) return NULL;
+    *len = strtoull(header, NULL, 10);
+    char *data = malloc(*len + 1);
+    if (!data) return NULL;
+    if (!read_all(fd, data, *len)) {
+        free(data);
+        return NULL;
+    }
+    data[*len] = '\0';
+    return data;
+}
+
+static bool has_prefix(const char *str, const char *prefix) {
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+// Options a worker runs: code generation, debug info, warnings and the language. Anything else
+// could read or write files or run programs on the worker, so the job is rejected. Advances *i
+// past the argument of -D, -U and -x.
+static bool worker_option_allowed(char **argv, size_t argc, size_t *i) {
+    const char *arg = argv[*i];
+    // -f options that write extra files or load code
+    const char *denied_f[] = { "-fdump-", "-fplugin", "-fprofile", "-fauto-profile", "-fcreate-profile",
+                               "-fbranch-probabilities", "-ftest-coverage", "-fstack-usage", "-fcallgraph-info",
+                               "-fopt-info", "-fsave-optimization-record", "-fcompare-debug", "-fdiagnostics-" };
+    const char *harmless[] = { "-w", "-pedantic", "-pedantic-errors", "-ansi", "-pthread", "-pipe" };
+
+    if (strcmp(arg, "-D") == 0 || strcmp(arg, "-U") == 0 || strcmp(arg, "-x") == 0) {
+        // Macros are no-ops on preprocessed input; the language must not look like an option
+        return ++*i < argc && argv[*i][0] != '-';
+    }
+    if (has_prefix(arg, "-D") || has_prefix(arg, "-U") || has_prefix(arg, "-O") || has_prefix(arg, "-std=") ||
+        has_prefix(arg, "-m") || has_prefix(arg, "-g")) {
+        return true;
+    }
+    if (has_prefix(arg, "-W")) return !has_prefix(arg, "-Wl,") && !has_prefix(arg, "-Wa,") && !has_prefix(arg, "-Wp,");
+    if (has_prefix(arg, "-f")) {
+        for (size_t d = 0; d < sizeof(denied_f) / sizeof(denied_f[0]); d++) {
+            if (has_prefix(arg, denied_f[d])) return false;
+        }
+        return true;
+    }
+    for (size_t h = 0; h < sizeof(harmless) / sizeof(harmless[0]); h++) {
+        if (strcmp(arg, harmless[h]) == 0) return true;
+    }
+    return false;
+}
+
+// Preprocessor and linker options mean nothing for preprocessed input and are not sent to workers;
+// returns how many words the option takes up, 0 to send it
+static size_t worker_local_option(const char *arg) {
+    const char *separate[] = { "-I", "-isystem", "-iquote", "-idirafter", "-include", "-imacros",
+                               "-MF", "-MT", "-MQ", "-L", "-l" };
+    const char *attached[] = { "-I", "-isystem", "-iquote", "-idirafter", "-M", "-L", "-l", "-Wl,", "-Wp," };
+    const char *link_only[] = { "-static", "-shared", "-rdynamic", "-pie", "-no-pie", "-s" };
+    for (size_t i = 0; i < sizeof(separate) / sizeof(separate[0]); i++) {
+        if (strcmp(arg, separate[i]) == 0) return 2;
+    }
+    for (size_t i = 0; i < sizeof(attached) / sizeof(attached[0]); i++) {
+        if (has_prefix(arg, attached[i])) return 1;
+    }
+    for (size_t i = 0; i < sizeof(link_only) / sizeof(link_only[0]); i++) {
+        if (strcmp(arg, link_only[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Runs one job inside a forked worker process
+static void worker_handle_job(int fd) {
+    char line[64];
+    size_t argc = 0, len;
+    if (!read_line(fd, line, sizeof(line)) || strcmp(line, "SAMBA-JOB 1") != 0) return;
+    if (!read_line(fd, line, sizeof(line)) || (argc = strtoul(line, NULL, 10)) == 0 || argc > 4096) return;
+
+    char **argv = calloc(argc + 6, sizeof(char *));
+    if (!argv) return;
+    for (size_t i = 0; i < argc; i++) {
+        if (!(argv[i] = read_blob(fd, &len))) return;
+    }
+    char *source = read_blob(fd, &len);
+    if (!source) return;
+
+    // The job has to name this worker's compiler, whose words are swapped for their resolved paths,
+    // so argv[0] is never a program the client picked
+    char *expected = strdup(S_COMPILER);
+    char *resolved = strdup(compiler_command());
+    if (!expected || !resolved) return;
+    char *save = NULL, *resolved_save = NULL;
+    size_t words = 0;
+    bool allowed = true;
+    char *word = strtok_r(expected, " ", &save);
+    char *path = strtok_r(resolved, " ", &resolved_save);
+    for (; word && allowed; word = strtok_r(NULL, " ", &save), path = strtok_r(NULL, " ", &resolved_save), words++) {
+        allowed = words < argc && path && strcmp(argv[words], word) == 0;
+        if (allowed) argv[words] = path;
+    }
+    for (size_t i = words; i < argc && allowed; i++) allowed = worker_option_allowed(argv, argc, &i);
+    if (!allowed) {
+        fprintf(stderr, "Worker: rejected a job that is not a plain %s compile\n", S_COMPILER);
+        write_all(fd, "SAMBA-REJECT\n", 13);
+        return;
+    }
+
+    char source_path[] = "/tmp/samba-job-XXXXXX";
+    char object_path[] = "/tmp/samba-obj-XXXXXX";
+    char error_path[] = "/tmp/samba-err-XXXXXX";
+    int source_fd = mkstemp(source_path);
+    int object_fd = mkstemp(object_path);
+    int error_fd = mkstemp(error_path);
+    if (source_fd < 0 || object_fd < 0 || error_fd < 0) return;
+    write_all(source_fd, source, len);
+    close(source_fd);
+    close(object_fd);
+
+    argv[argc] = "-c";
+    argv[argc + 1] = source_path;
+    argv[argc + 2] = "-o";
+    argv[argc + 3] = object_path;
+
+    int status = 127;
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(error_fd, STDERR_FILENO);
+        dup2(error_fd, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        _exit(127);
+    } else if (pid > 0) {
+        int wstatus;
+        waitpid(pid, &wstatus, 0);
+        status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128;
+    }
+    close(error_fd);
+
+    size_t error_len = 0, object_len = 0;
+    char *error = read_whole_file(error_path, &error_len);
+    char *object = status == 0 ? read_whole_file(object_path, &object_len) : NULL;
+    if (!object) object_len = 0;
+
+    char header[128];
+    int n = snprintf(header, sizeof(header), "SAMBA-OK %d %zu %zu\n", status, error_len, object_len);
+    if (write_all(fd, header, n) && (!error_len || write_all(fd, error, error_len))) {
+        if (object_len) write_all(fd, object, object_len);
+    }
+
+    remove(source_path);
+    remove(object_path);
+    remove(error_path);
+    // Split DWARF is never requested (see compile), but a stray .dwo must not pile up in /tmp
+    char dwo_path[sizeof(object_path) + 4];
+    snprintf(dwo_path, sizeof(dwo_path), "%s.dwo", object_path);
+    remove(dwo_path);
+}
+
+/*
+  @name run_worker
+  @parameters int port, int slots
+  @description Serves compile jobs on port, running at most slots at once (0 = number of CPUs) | Never returns on success
+  @returns int
+*/
+int run_worker(int port, int slots) {
+    if (slots <= 0) slots = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (slots <= 0) slots = 1;
+
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        perror("socket");
+        return S_ERROR;
+    }
+    int yes = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    const char *host = worker_address ? worker_address : "127.0.0.1";
+    struct sockaddr_in address = { 0 };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1) {
+        fprintf(stderr, "Error: Invalid worker address '%s'.\n", host);
+        close(server);
+        return S_ERROR;
+    }
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 64) != 0) {
+        perror("bind");
+        close(server);
+        return S_ERROR;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    printf("Samba worker listening on %s:%d (%d slots)\n", host, port, slots);
+
+    int active = 0;
+    for (;;) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) continue;
+
+        while (active > 0 && waitpid(-1, NULL, WNOHANG) > 0) active--;
+        if (active >= slots) {
+            write_all(client, "SAMBA-BUSY\n", 11);
+            close(client);
+            continue;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(server);
+            set_socket_timeout(client, S_WORKER_TIMEOUT);
+            worker_handle_job(client);
+            close(client);
+            _exit(0);
+        }
+        if (pid > 0) active++;
+        close(client);
+        verbose_log("Worker: accepted job (%d/%d slots busy)\n", active, slots);
+    }
+}
+
+static int connect_worker(const char *worker) {
+    char host[256];
+    char port[16];
+    snprintf(host, sizeof(host), "%s", worker);
+    snprintf(port, sizeof(port), "%d", S_WORKER_PORT);
+    char *colon = strrchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        snprintf(port, sizeof(port), "%s", colon + 1);
+    }
+
+    struct addrinfo hints = { 0 }, *result;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &result) != 0) return -1;
+
+    int fd = -1;
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        // Also bounds connect() on Linux; a hung worker then falls back to a local compile
+        set_socket_timeout(fd, S_WORKER_TIMEOUT);
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    return fd;
+}
+
+// Sends a job to one worker; returns the compiler status, or -1 if the worker was busy or unreachable
+static int send_job(const char *worker, char **argv, size_t argc, const char *source, size_t source_len,
+                    const char *object_file) {
+    int fd = connect_worker(worker);
+    if (fd < 0) return -1;
+
+    char header[64];
+    int n = snprintf(header, sizeof(header), "SAMBA-JOB 1\n%zu\n", argc);
+    bool sent = write_all(fd, header, n);
+    for (size_t i = 0; sent && i < argc; i++) sent = write_blob(fd, argv[i], strlen(argv[i]));
+    if (sent) sent = write_blob(fd, source, source_len);
+
+    char line[128];
+    int status = -1;
+    size_t error_len, object_len;
+    if (sent && read_line(fd, line, sizeof(line)) &&
+        sscanf(line, "SAMBA-OK %d %zu %zu", &status, &error_len, &object_len) == 3) {
+        char *error = malloc(error_len + 1);
+        char *object = malloc(object_len + 1);
+        if (error && object && read_all(fd, error, error_len) && read_all(fd, object, object_len)) {
+            if (error_len) fwrite(error, 1, error_len, stderr);
+            if (status == 0 && !write_whole_file(object_file, object, object_len)) status = 1;
+        } else {
+            status = -1;
+        }
+        free(error);
+        free(object);
+    } else {
+        status = -1;
+    }
+    close(fd);
+    return status;
+}
+
+/*
+  @name preprocess_source
+  @parameters char *script_file, char *output_path, size_t *len
+  @description Runs the preprocessor with all given configuration and returns its output
+  @returns char *
+*/
+char *preprocess_source(const char *script_file, const char *output_path, size_t *len) {
+    char preprocessed[PATH_MAX];
+    snprintf(preprocessed, sizeof(preprocessed), "%s.samba.i", output_path);
+
+    char *command = NULL;
+    size_t command_len = 0, command_capacity = 0;
+    command_append(&command, &command_len, &command_capacity, "%s -E ", compiler_command());
+    for (size_t i = 0; i < num_variables; i++) {
+        command_append(&command, &command_len, &command_capacity, "-D%s='\"%s\"' ", variables[i].key, variables[i].value);
+    }
+    for (size_t i = 0; i < num_includes; i++) {
+        command_append(&command, &command_len, &command_capacity, "-I%s ", includes[i].key);
+    }
+    for (size_t i = 0; i < num_flags; i++) {
+        if (strcmp(flags[i], "-c") != 0) command_append(&command, &command_len, &command_capacity, "%s ", flags[i]);
+    }
+    command_append(&command, &command_len, &command_capacity, "-o %s %s", preprocessed, script_file);
+    verbose_log("Executing command: %s\n", command);
+    int status = system(command);
+    free(command);
+    if (status != 0) {
+        remove(preprocessed);
+        return NULL;
+    }
+
+    char *source = read_whole_file(preprocessed, len);
+    remove(preprocessed);
+    return source;
+}
+
+/*
+  @name dispatch_compile
+  @parameters char *script_file, char *source, size_t source_len, char *object_file
+  @description Compiles the preprocessed source of script_file to object_file on a free worker
+  @returns int | compiler status, or -1 if no worker took the job (compile locally)
+*/
+int dispatch_compile(const char *script_file, const char *source, size_t source_len, const char *object_file) {
+    if (num_workers == 0 || !source) return -1;
+
+    // Flags are split and unquoted the way the shell does it for local compiles, so "-O2 -g" is two
+    // words; anything that would need command substitution is compiled locally
+    wordexp_t words;
+    if (wordexp("", &words, 0) != 0) return -1;
+    for (size_t i = 0; i < num_flags; i++) {
+        if (strcmp(flags[i], "-c") == 0) continue;
+        if (wordexp(flags[i], &words, WRDE_APPEND | WRDE_NOCMD) != 0) {
+            wordfree(&words);
+            return -1;
+        }
+    }
+
+    // Compiler words, flags, then the language of the preprocessed input
+    char *compiler = strdup(S_COMPILER);
+    char **argv = malloc(sizeof(char *) * (words.we_wordc + 8 + strlen(S_COMPILER)));
+    size_t argc = 0;
+    char *save = NULL;
+    for (char *word = strtok_r(compiler, " ", &save); word; word = strtok_r(NULL, " ", &save)) argv[argc++] = word;
+    for (size_t i = 0; i < words.we_wordc; i++) {
+        size_t skip = worker_local_option(words.we_wordv[i]);
+        if (skip) i += skip - 1;
+        else argv[argc++] = words.we_wordv[i];
+    }
+    const char *ext = strrchr(script_file, '.');
+    bool cxx = ext && (strcmp(ext, ".cpp") == 0 || strcmp(ext, ".cc") == 0 || strcmp(ext, ".cxx") == 0);
+    argv[argc++] = "-x";
+    argv[argc++] = cxx ? "c++-cpp-output" : "cpp-output";
+
+    int status = -1;
+    unsigned int start = __sync_fetch_and_add(&next_worker, 1);
+    for (size_t i = 0; i < num_workers && status < 0; i++) {
+        const char *worker = workers[(start + i) % num_workers];
+        status = send_job(worker, argv, argc, source, source_len, object_file);
+        if (status >= 0) verbose_log("Compiled '%s' on worker %s\n", script_file, worker);
+    }
+    if (status < 0) verbose_log("All workers busy, compiling '%s' locally\n", script_file);
+
+    free(argv);
+    free(compiler);
+    wordfree(&words);
+    return status;
+}
+
+// -- Object Cache --
+// Objects of `-c` compiles are cached by the hash of the preprocessed source and the command.
+// Layout (local directory and remote HTTP cache alike): ac/<key> holds the digest of the object,
+// cas/<digest> holds the object itself. Remote uploads run on a background thread.
+char *cache_directory = NULL;
+char *remote_cache_url = NULL;
+static bool object_cache_on = false;
+
+/*
+  @name enable_object_cache
+  @parameters void
+  @description Enables the local object cache (default directory: $XDG_CACHE_HOME/samba or ~/.cache/samba)
+  @returns void
+*/
+void enable_object_cache() {
+    object_cache_on = true;
+}
+
+/*
+  @name set_cache_directory
+  @parameters char *path
+  @description Sets the directory of the local object cache and enables it
+  @returns void
+*/
+void set_cache_directory(const char *path) {
+    cache_directory = strdup(path);
+    if (!cache_directory) exit_error(__func__, "Failed to set cache directory");
+    object_cache_on = true;
+}
+
+static bool object_cache_enabled() {
+    return object_cache_on || remote_cache_url != NULL;
+}
+
+static const char *object_cache_root() {
+    if (!cache_directory) {
+        char path[PATH_MAX];
+        const char *xdg = getenv("XDG_CACHE_HOME");
+        const char *home = getenv("HOME");
+        if (xdg && *xdg) snprintf(path, sizeof(path), "%s/samba", xdg);
+        else if (home && *home) snprintf(path, sizeof(path), "%s/.cache/samba", home);
+        else snprintf(path, sizeof(path), "%s/.cache", build_directory ? build_directory : ".");
+        cache_directory = strdup(path);
+    }
+    return cache_directory;
+}
+
+// 128-bit digest from two FNV-1a chains, as 32 hex chars
+static void digest_hex(const void *data, size_t len, unsigned long long seed, char out[33]) {
+    unsigned long long a = hash_bytes(data, len, seed ^ 0x6a09e667f3bcc908ULL);
+    unsigned long long b = hash_bytes(data, len, seed ^ 0xbb67ae8584caa73bULL);
+    snprintf(out, 33, "%016llx%016llx", a, b);
+}
+
+/*
+  @name object_cache_key
+  @parameters char *script_file, char *source, size_t len, char *key
+  @description Action key of a compile: compiler fingerprint, flags, language and preprocessed source
+  @returns void
+*/
+void object_cache_key(const char *script_file, const char *source, size_t len, char key[33]) {
+    unsigned long long seed = hash_bytes(S_COMPILER, strlen(S_COMPILER) + 1, compiler_fingerprint()->hash);
+    for (size_t i = 0; i < num_flags; i++) seed = hash_bytes(flags[i], strlen(flags[i]) + 1, seed);
+    const char *ext = strrchr(script_file, '.');
+    if (ext) seed = hash_bytes(ext, strlen(ext) + 1, seed);
+    digest_hex(source, len, seed, key);
+}
+
+static void object_cache_path(char *path, size_t size, const char *kind, const char *name) {
+    snprintf(path, size, "%s/%s/%.2s/%s", object_cache_root(), kind, name, name);
+}
+
+static bool object_cache_put_local(const char *kind, const char *name, const void *data, size_t len) {
+    char path[PATH_MAX];
+    char temp[PATH_MAX];
+    object_cache_path(path, sizeof(path), kind, name);
+
+    char *slash = strrchr(path, '/');
+    *slash = '\0';
+    make_directories(path);
+    *slash = '/';
+
+    // Write then rename, so concurrent builds never see half an object
+    snprintf(temp, sizeof(temp), "%s.%d.%lx", path, (int)getpid(), (unsigned long)pthread_self());
+    if (!write_whole_file(temp, data, len)) {
+        remove(temp);
+        return false;
+    }
+    return rename(temp, path) == 0;
+}
+
+static char *object_cache_get_local(const char *kind, const char *name, size_t *len) {
+    char path[PATH_MAX];
+    object_cache_path(path, sizeof(path), kind, name);
+    return read_whole_file(path, len);
+}
+
+#ifdef S_CURLE
+typedef struct upload_job {
+    char path[80];
+    char *data;
+    size_t len;
+    struct upload_job *next;
+} upload_job_t;
+
+static pthread_mutex_t upload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t upload_cond = PTHREAD_COND_INITIALIZER;
+static upload_job_t *upload_head = NULL;
+static upload_job_t *upload_tail = NULL;
+static int uploads_pending = 0;
+static bool upload_thread_started = false;
+static pthread_once_t curl_once = PTHREAD_ONCE_INIT;
+
+static void cache_curl_init() {
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+static size_t cache_write_callback(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    size_t total = size * nmemb;
+    char **buffer = ((char ***)userdata)[0];
+    size_t *len = ((size_t **)userdata)[1];
+    char *temp = realloc(*buffer, *len + total + 1);
+    if (!temp) return 0;
+    memcpy(temp + *len, ptr, total);
+    *len += total;
+    temp[*len] = '\0';
+    *buffer = temp;
+    return total;
+}
+
+/*
+  @name remote_cache_request
+  @parameters char *method, char *path, char **data, size_t *len
+  @description GET or PUT of path (ac/<key> or cas/<digest>) on the remote cache | GET fills data/len
+  @returns bool | true on HTTP 200/201/204
+*/
+bool remote_cache_request(const char *method, const char *path, char **data, size_t *len) {
+    pthread_once(&curl_once, cache_curl_init);
+    CURL *curl = curl_easy_init();
+    if (!curl) return false;
+
+    char url[PATH_MAX];
+    size_t base_len = strlen(remote_cache_url);
+    snprintf(url, sizeof(url), "%s%s%s", remote_cache_url,
+             base_len && remote_cache_url[base_len - 1] == '/' ? "" : "/", path);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+
+    struct curl_slist *headers = NULL;
+    void *sink[2] = { data, len };
+    if (strcmp(method, "PUT") == 0) {
+        headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, *data);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)*len);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    } else {
+        *data = NULL;
+        *len = 0;
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, cache_write_callback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, sink);
+    }
+
+    long code = 0;
+    CURLcode res = curl_easy_perform(curl);
+    if (res == CURLE_OK) curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    bool ok = res == CURLE_OK && (code == 200 || code == 201 || code == 204);
+    if (!ok && strcmp(method, "GET") == 0) {
+        free(*data);
+        *data = NULL;
+    }
+    return ok;
+}
+
+static void *upload_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&upload_mutex);
+        while (!upload_head) pthread_cond_wait(&upload_cond, &upload_mutex);
+        upload_job_t *job = upload_head;
+        upload_head = job->next;
+        if (!upload_head) upload_tail = NULL;
+        pthread_mutex_unlock(&upload_mutex);
+
+        if (!remote_cache_request("PUT", job->path, &job->data, &job->len)) {
+            verbose_log("Remote cache: upload of %s failed\n", job->path);
+        }
+        free(job->data);
+        free(job);
+
+        pthread_mutex_lock(&upload_mutex);
+        uploads_pending--;
+        pthread_cond_broadcast(&upload_cond);
+        pthread_mutex_unlock(&upload_mutex);
+    }
+    return NULL;
+}
+
+/*
+  @name flush_remote_cache
+  @parameters void
+  @description Waits until all queued uploads reached the remote cache | Runs automatically at exit
+  @returns void
+*/
+void flush_remote_cache() {
+    pthread_mutex_lock(&upload_mutex);
+    while (uploads_pending > 0) pthread_cond_wait(&upload_cond, &upload_mutex);
+    pthread_mutex_unlock(&upload_mutex);
+}
+
+static void remote_cache_upload(const char *kind, const char *name, const void *data, size_t len) {
+    upload_job_t *job = malloc(sizeof(upload_job_t));
+    if (!job) return;
+    job->data = malloc(len ? len : 1);
+    if (!job->data) {
+        free(job);
+        return;
+    }
+    memcpy(job->data, data, len);
+    job->len = len;
+    job->next = NULL;
+    snprintf(job->path, sizeof(job->path), "%s/%s", kind, name);
+
+    pthread_mutex_lock(&upload_mutex);
+    if (!upload_thread_started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, upload_thread, NULL) == 0) {
+            pthread_detach(thread);
+            upload_thread_started = true;
+            atexit(flush_remote_cache);
+        }
+    }
+    if (upload_tail) upload_tail->next = job;
+    else upload_head = job;
+    upload_tail = job;
+    uploads_pending++;
+    pthread_cond_signal(&upload_cond);
+    pthread_mutex_unlock(&upload_mutex);
+}
+#endif // S_CURLE
+
+/*
+  @name set_remote_cache
+  @parameters char *url
+  @description Shares objects through an HTTP cache (GET/PUT of /ac/<key> and /cas/<digest>) | Needs S_CURLE | initialize_build_flags reads $SAMBA_REMOTE_CACHE
+  @returns int
+*/
+int set_remote_cache(const char *url) {
+#ifdef S_CURLE
+    remote_cache_url = strdup(url);
+    return remote_cache_url ? 0 : S_ERROR;
+#else
+    fprintf(stderr, "Error: set_remote_cache(%s) needs S_CURLE.\n", url);
+    return S_ERROR;
+#endif
+}
+
+/*
+  @name object_cache_fetch
+  @parameters char *key, char *output_path
+  @description Restores the object of key from the local cache, then from the remote cache
+  @returns bool
+*/
+bool object_cache_fetch(const char *key, const char *output_path) {
+    size_t len;
+    char digest[33];
+    char *action = object_cache_get_local("ac", key, &len);
+    char *object = NULL;
+
+    if (action && len >= 32) {
+        snprintf(digest, sizeof(digest), "%.32s", action);
+        object = object_cache_get_local("cas", digest, &len);
+    }
+    free(action);
+
+#ifdef S_CURLE
+    if (!object && remote_cache_url) {
+        char path[80];
+        snprintf(path, sizeof(path), "ac/%s", key);
+        if (remote_cache_request("GET", path, &action, &len) && len >= 32) {
+            snprintf(digest, sizeof(digest), "%.32s", action);
+            snprintf(path, sizeof(path), "cas/%s", digest);
+            if (remote_cache_request("GET", path, &object, &len)) {
+                char check[33];
+                digest_hex(object, len, 0, check);
+                if (strcmp(check, digest) == 0) {
+                    object_cache_put_local("cas", digest, object, len);
+                    object_cache_put_local("ac", key, digest, 32);
+                    verbose_log("Remote cache hit: %s\n", key);
+                } else {
+                    free(object);
+                    object = NULL;
+                }
+            }
+        }
+        free(action);
+    }
+#endif
+
+    if (!object) return false;
+    bool ok = write_whole_file(output_path, object, len);
+    free(object);
+    return ok;
+}
+
+/*
+  @name object_cache_store
+  @parameters char *key, char *output_path
+  @description Stores a freshly compiled object in the local cache and queues its upload
+  @returns void
+*/
+void object_cache_store(const char *key, const char *output_path) {
+    size_t len;
+    char *object = read_whole_file(output_path, &len);
+    if (!object) return;
+
+    char digest[33];
+    digest_hex(object, len, 0, digest);
+    object_cache_put_local("cas", digest, object, len);
+    object_cache_put_local("ac", key, digest, 32);
+
+#ifdef S_CURLE
+    if (remote_cache_url) {
+        remote_cache_upload("cas", digest, object, len);
+        remote_cache_upload("ac", key, digest, 32);
+    }
+#endif
+    free(object);
+}
+
+/*
+  @name compile
+  @parameters char *script_file, char *output_file, bool create_shared
+  @description Compiles a script file into an executable file with all given configuration.
+  @returns void
+*/
+void compile(const char *script_file, const char *output_file, bool create_shared) {
+    #ifdef S_CACHE_COMPILATION
+        if (!check_tool("ccache")) {
+            if (check_tool("dnf")) {
+                system("sudo dnf install ccache -y");
+                system("clear");
+            }
+            else if (check_tool("apt-get")) {
+                system("sudo apt-get install ccache");
+                system("clear");
+            }
+            else {
+                printf("ccache not found. Please install ccache.\n");
+                return;
+            }
+        }
+    #endif
+    char *command = NULL;
+    size_t command_len = 0, command_capacity = 0;
+    command_append(&command, &command_len, &command_capacity, "%s ", compiler_command());
+
+    for (size_t i = 0; i < num_variables; i++) {
+            command_append(&command, &command_len, &command_capacity, "-D%s='\"%s\"' ", variables[i].key, variables[i].value);
+    }
+    for (size_t i = 0; i < num_includes; i++) {
+        command_append(&command, &command_len, &command_capacity, "-I%s ", includes[i].key);
+    }
+    for (size_t i = 0; i < num_library_paths; i++) {
+        command_append(&command, &command_len, &command_capacity, "-L%s ", library_paths[i].key);
+    }
+    for (size_t i = 0; i < num_libraries; i++) {
+        command_append(&command, &command_len, &command_capacity, "-l%s ", libraries[i].key);
+    }
+    for (size_t i = 0; i < num_flags; i++) {
+        command_append(&command, &command_len, &command_capacity, "%s ", flags[i]);
+    }
+    if (create_shared) {
+        command_append(&command, &command_len, &command_capacity, "-shared ");
+    }
+    if (!has_flag("-c")) {
+        command_append(&command, &command_len, &command_capacity, "%s", toolchain_link_flags());
+    }
+    if (build_directory == NULL) {
+        command_append(&command, &command_len, &command_capacity, "-o %s %s", output_file, script_file);
+    }
+    else {
+        command_append(&command, &command_len, &command_capacity, "-o %s/%s %s", build_directory, output_file, script_file);
+        if (!build_directory_exists(build_directory)) {
+            if (verbose_mode) {
+            printf("Build directory '%s' does not exist. Creating it...\n", build_directory);
+            }
+            if (mkdir(build_directory, 0755) != 0) {
+                exit_error(__func__, "Failed to create build directory");
+            }
+            verbose_log("Build directory created successfully.\n");
+        }
+    }
+
+
+    char output_path[PATH_MAX];
+    if (build_directory == NULL) snprintf(output_path, sizeof(output_path), "%s", output_file);
+    else snprintf(output_path, sizeof(output_path), "%s/%s", build_directory, output_file);
+
+    bool object_only = has_flag("-c");
+    // With split DWARF the compiler writes a .dwo next to the object, which neither the cache nor
+    // the worker protocol carry, so those builds always compile locally
+    bool split_dwarf = has_flag("-gsplit-dwarf");
+    bool cached = object_only && !create_shared && !split_dwarf && object_cache_enabled();
+    bool distributed = num_workers > 0 && !create_shared && !split_dwarf;
+    char cache_key[33] = "";
+    size_t source_len = 0;
+    char *source = NULL;
+    if (cached || distributed) {
+        source = preprocess_source(script_file, output_path, &source_len);
+    }
+    if (source && cached) {
+        object_cache_key(script_file, source, source_len, cache_key);
+        if (object_cache_fetch(cache_key, output_path)) {
+            free(source);
+            free(command);
+            printf("Compilation successful (cached): %s\n", output_file);
+            return;
+        }
+    }
+
+    int status = -1;
+    if (source && distributed) {
+        if (object_only) {
+            status = dispatch_compile(script_file, source, source_len, output_path);
+        } else {
+            // Compile remotely, link locally
+            char object_path[PATH_MAX];
+            snprintf(object_path, sizeof(object_path), "%s.samba.o", output_path);
+            status = dispatch_compile(script_file, source, source_len, object_path);
+            if (status == 0) {
+                char *link = NULL;
+                size_t link_len = 0, link_capacity = 0;
+                command_append(&link, &link_len, &link_capacity, "%s ", compiler_command());
+                for (size_t i = 0; i < num_flags; i++) {
+                    command_append(&link, &link_len, &link_capacity, "%s ", flags[i]);
+                }
+                command_append(&link, &link_len, &link_capacity, "%s-o %s %s", toolchain_link_flags(), output_path, object_path);
+                for (size_t i = 0; i < num_library_paths; i++) {
+                    command_append(&link, &link_len, &link_capacity, " -L%s", library_paths[i].key);
+                }
+                for (size_t i = 0; i < num_libraries; i++) {
+                    command_append(&link, &link_len, &link_capacity, " -l%s", libraries[i].key);
+                }
+                verbose_log("Executing command: %s\n", link);
+                status = system(link) != 0;
+                free(link);
+            }
+            remove(object_path);
+        }
+    }
+    free(source);
+
+    if (status < 0) {
+        verbose_log("Executing command: %s\n", command);
+        status = system(command) != 0;
+    }
+    if (status != 0) {
+        fprintf(stderr, "Error: Compilation failed.\n");
+    } else {
+        if (cache_key[0]) object_cache_store(cache_key, output_path);
+        printf("Compilation successful: %s\n", output_file);
+    }
+    free(command);
+}
+
+/*
+  @name free_all
+  @parameters void
+  @description Frees All
+  @returns void
+*/
+void free_all() {
+    free(libraries);
+    free(includes);
+    free(library_paths);
+    free(flags);
+    libraries = includes = library_paths = NULL;
+    flags = NULL;
+    table_clear(&flag_index, false);
+    table_clear(&library_index, false);
+    num_libraries = num_includes = num_library_paths = num_flags = 0;
+}
+
+/*
+  @name reset_settings
+  @parameters void
+  @description Frees All | Is made if your wanna make 2 targets or more with different flags
+  @returns void
+*/
+void reset_settings() {
+    free_all();
+    #undef verbose_mode
+    #define verbose_mode false
+}
+
+/*
+  @name needs_rebuild
+  @parameters char *source_file, char *executable
+  @description Used in SAMBA_GO_REBUILD_URSELF | you can also use it
+  @returns int
+*/
+int needs_rebuild(const char *source_file, const char *executable) {
+    struct stat source_stat, exe_stat;
+
+    if (stat(source_file, &source_stat) != 0) {
+        fprintf(stderr, "Error: Source file '%s' not found.\n", source_file);
+        return 1;
+    }
+
+    if (stat(executable, &exe_stat) != 0) {
+        fprintf(stderr, "Warning: Executable '%s' not found.\n", executable);
+        return 1;
+    }
+
+    if (source_stat.st_mtime > exe_stat.st_mtime) {
+        #ifndef S_REBUILD_NO_OUTPUT
+            verbose_log("Source file '%s' is newer than executable '%s'. Rebuild required.\n", source_file, executable);
+        #endif
+
+        return 1;
+    }
+
+    #ifndef S_REBUILD_NO_OUTPUT
+        verbose_log("Executable '%s' is up-to-date. Running...\n", executable);
+    #endif
+    return 0;
+}
+
+/*
+  @name file_exists
+  @parameters char *path
+  @description Checks if the given file exists
+  @returns bool
+*/
+bool file_exists(const char *path) {
+    struct stat buffer;
+    return (stat(path, &buffer) == 0);
+}
+
+/*
+  @name SAMBA_GO_REBUILD_URSELF
+  @parameters void
   @description Checks if the samba.c binary is uptodate | Idea taken from tsoding | Implementation self made
   @returns void
 */
@@ -577,63 +2301,360 @@ void SAMBA_GO_REBUILD_URSELF() {
 }
 
 /*
-  @name initialize_build_flags
-  @parameters void
-  @description Inits the build flags (S_RELEASE_MODE or S_DEBUG_MODE)
-  @returns void
+  @name initialize_build_flags
+  @parameters void
+  @description Inits the build flags (S_RELEASE_MODE or S_DEBUG_MODE)
+  @returns void
+*/
+void initialize_build_flags() {
+    // Modes
+    #ifdef S_RELEASE_MODE
+        add_flag("-O2");
+        add_flag("-DNDEBUG");
+        add_flag("-s");
+    #endif
+
+    #ifdef S_DEBUG_MODE
+        add_flag("-O0");
+        add_flag("-g");
+    #endif
+
+    #ifdef S_CURLE
+        if (getenv("SAMBA_REMOTE_CACHE") && !remote_cache_url) set_remote_cache(getenv("SAMBA_REMOTE_CACHE"));
+    #endif
+
+    // Toolchain capabilities (fast linker, split DWARF)
+    probe_toolchain();
+    #ifdef S_DEBUG_MODE
+        if (toolchain.split_dwarf) add_flag("-gsplit-dwarf");
+    #endif
+
+    // Integrate Samba Vars to the output executable
+    define_variable("S_VERSION", S_VERSION);
+    define_variable("S_COMPILER", S_COMPILER);
+}
+
+// -- pkg-config --
+// .pc files are parsed in-process: variables are expanded, Requires are resolved recursively and
+// the resulting flags deduplicated. Results go to the probe cache with every .pc file they were built
+// from as inputs; adding or removing a .pc file in a search directory invalidates all of them.
+typedef struct {
+    char *path;
+    table_t variables;
+    char *cflags;
+    char *libs;
+    char *requires;
+    char *requires_private;
+} pc_module_t;
+
+static table_t pc_modules = { 0 };
+static pthread_mutex_t pc_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Calls `visit` for each directory pkg-config would search, in order, until it returns a result
+static char *pc_each_directory(char *(*visit)(const char *, size_t, void *), void *data) {
+    const char *lists[2] = { getenv("PKG_CONFIG_PATH"), getenv("PKG_CONFIG_LIBDIR") };
+    const char *defaults =
+        "/usr/local/lib/pkgconfig:/usr/local/share/pkgconfig:"
+    #if defined(__x86_64__)
+        "/usr/lib/x86_64-linux-gnu/pkgconfig:"
+    #elif defined(__aarch64__)
+        "/usr/lib/aarch64-linux-gnu/pkgconfig:"
+    #endif
+        "/usr/lib64/pkgconfig:/usr/lib/pkgconfig:/usr/share/pkgconfig";
+    if (!lists[1]) lists[1] = defaults;
+
+    for (int l = 0; l < 2; l++) {
+        for (const char *dir = lists[l]; dir && *dir; ) {
+            const char *end = strchr(dir, ':');
+            size_t len = end ? (size_t)(end - dir) : strlen(dir);
+            if (len > 0) {
+                char *result = visit(dir, len, data);
+                if (result) return result;
+            }
+            dir = end ? end + 1 : NULL;
+        }
+    }
+    return NULL;
+}
+
+static char *pc_visit_module(const char *dir, size_t len, void *data) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s/%s.pc", (int)len, dir, (const char *)data);
+    return access(path, R_OK) == 0 ? strdup(path) : NULL;
+}
+
+// Any added or removed .pc file changes the mtime of its directory
+static char *pc_visit_key(const char *dir, size_t len, void *data) {
+    char path[PATH_MAX];
+    struct stat info;
+    snprintf(path, sizeof(path), "%.*s", (int)len, dir);
+    unsigned long long *key = data;
+    *key = hash_bytes(path, strlen(path) + 1, *key);
+    if (stat(path, &info) == 0) *key = hash_bytes(&info.st_mtime, sizeof(info.st_mtime), *key);
+    return NULL;
+}
+
+static unsigned long long pc_key = 0;
+static pthread_once_t pc_key_once = PTHREAD_ONCE_INIT;
+
+static void pc_compute_key() {
+    pc_key = hash_bytes("pkg-config", 10, 0);
+    pc_each_directory(pc_visit_key, &pc_key);
+}
+
+static unsigned long long pc_search_key() {
+    pthread_once(&pc_key_once, pc_compute_key);
+    return pc_key;
+}
+
+// Expands ${name} references; $$ is a literal $
+static char *pc_expand(pc_module_t *module, const char *value, int depth) {
+    char *out = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&out, &len, &capacity, "%s", "");
+
+    for (const char *p = value; *p; p++) {
+        if (p[0] == '$' && p[1] == '$') {
+            command_append(&out, &len, &capacity, "$");
+            p++;
+        } else if (p[0] == '$' && p[1] == '{' && strchr(p, '}')) {
+            const char *end = strchr(p, '}');
+            char name[256];
+            snprintf(name, sizeof(name), "%.*s", (int)(end - p - 2), p + 2);
+            char *variable = table_get(&module->variables, name);
+            if (variable && depth < 16) {
+                char *expanded = pc_expand(module, variable, depth + 1);
+                command_append(&out, &len, &capacity, "%s", expanded);
+                free(expanded);
+            } else if (!variable) {
+                verbose_log("pkg-config: undefined variable '%s' in %s\n", name, module->path);
+            }
+            p = end;
+        } else {
+            command_append(&out, &len, &capacity, "%c", *p);
+        }
+    }
+    return out;
+}
+
+static pc_module_t *pc_parse(const char *path) {
+    size_t size;
+    char *text = read_whole_file(path, &size);
+    if (!text) return NULL;
+
+    pc_module_t *module = calloc(1, sizeof(pc_module_t));
+    if (!module) exit_error(__func__, "Out of memory");
+    module->path = strdup(path);
+
+    char directory[PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s", path);
+    char *slash = strrchr(directory, '/');
+    if (slash) *slash = '\0';
+    *table_put(&module->variables, "pcfiledir") = strdup(directory);
+
+    char *save = NULL;
+    for (char *line = strtok_r(text, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        // A trailing backslash continues the line
+        size_t line_len = strlen(line);
+        while (line_len > 0 && line[line_len - 1] == '\\' && save && *save) {
+            line[line_len - 1] = ' ';
+            char *next = strtok_r(NULL, "\n", &save);
+            if (!next) break;
+            memmove(line + line_len, next, strlen(next) + 1);
+            line_len = strlen(line);
+        }
+
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        while (*line == ' ' || *line == '\t') line++;
+
+        size_t name_len = strcspn(line, "=: \t");
+        char *separator = line + name_len;
+        while (*separator == ' ' || *separator == '\t') separator++;
+        if (name_len == 0 || (*separator != '=' && *separator != ':')) continue;
+
+        char kind = *separator;
+        line[name_len] = '\0';
+        char *value = separator + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        char *value_end = value + strlen(value);
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t' || value_end[-1] == '\r')) *--value_end = '\0';
+
+        if (kind == '=') {
+            void **slot = table_put(&module->variables, line);
+            free(*slot);
+            *slot = strdup(value);
+            continue;
+        }
+
+        char **field = NULL;
+        if (strcmp(line, "Cflags") == 0 || strcmp(line, "CFlags") == 0) field = &module->cflags;
+        else if (strcmp(line, "Libs") == 0) field = &module->libs;
+        else if (strcmp(line, "Requires") == 0) field = &module->requires;
+        else if (strcmp(line, "Requires.private") == 0) field = &module->requires_private;
+        if (field) {
+            free(*field);
+            *field = pc_expand(module, value, 0);
+        }
+    }
+    free(text);
+    return module;
+}
+
+static pc_module_t *pc_module(const char *name) {
+    pthread_mutex_lock(&pc_mutex);
+    void **slot = table_put(&pc_modules, name);
+    if (!*slot) {
+        char *path = pc_each_directory(pc_visit_module, (void *)name);
+        if (path) {
+            *slot = pc_parse(path);
+            free(path);
+        }
+    }
+    pc_module_t *module = *slot;
+    pthread_mutex_unlock(&pc_mutex);
+    return module;
+}
+
+// Flags pkg-config drops by default because the compiler searches these directories anyway
+static bool pc_system_flag(const char *flag) {
+    const char *system_flags[] = {
+        "-I/usr/include", "-L/usr/lib", "-L/usr/lib64", "-L/lib", "-L/lib64",
+    #if defined(__x86_64__)
+        "-L/usr/lib/x86_64-linux-gnu", "-L/lib/x86_64-linux-gnu",
+    #elif defined(__aarch64__)
+        "-L/usr/lib/aarch64-linux-gnu", "-L/lib/aarch64-linux-gnu",
+    #endif
+    };
+    for (size_t i = 0; i < sizeof(system_flags) / sizeof(system_flags[0]); i++) {
+        if (strcmp(flag, system_flags[i]) == 0) return true;
+    }
+    return false;
+}
+
+// Expands `name` and everything it requires, depth first, the way pkg-config does before deduplication
+static bool pc_collect(const char *name, bool libs, int depth, table_t *visited, char ***flags, int *count, int *capacity,
+                       char **files, size_t *files_len, size_t *files_capacity) {
+    pc_module_t *module = pc_module(name);
+    if (!module) {
+        verbose_log("pkg-config: package '%s' not found\n", name);
+        return false;
+    }
+    if (depth > 64) {
+        verbose_log("pkg-config: Requires of '%s' are cyclic\n", name);
+        return false;
+    }
+
+    if (!table_get(visited, name)) {
+        *table_put(visited, name) = (void *)1;
+        probe_input(files, files_len, files_capacity, module->path);
+    }
+
+    char *own = libs ? module->libs : module->cflags;
+    char *copy = strdup(own ? own : "");
+    char *save = NULL;
+    for (char *flag = strtok_r(copy, " \t", &save); flag; flag = strtok_r(NULL, " \t", &save)) {
+        if (*count == *capacity) {
+            *capacity = *capacity ? *capacity * 2 : 32;
+            *flags = realloc(*flags, *capacity * sizeof(char *));
+            if (!*flags) exit_error(__func__, "Out of memory");
+        }
+        (*flags)[(*count)++] = strdup(flag);
+    }
+    free(copy);
+
+    // Requires.private contributes cflags only, as with `pkg-config --cflags`
+    char *requires[2] = { module->requires, libs ? NULL : module->requires_private };
+    for (int r = 0; r < 2; r++) {
+        if (!requires[r]) continue;
+        copy = strdup(requires[r]);
+        save = NULL;
+        bool skip_version = false;
+        for (char *token = strtok_r(copy, " \t,", &save); token; token = strtok_r(NULL, " \t,", &save)) {
+            if (strchr("<>=!", token[0])) {
+                skip_version = true;
+                continue;
+            }
+            if (skip_version) {
+                skip_version = false;
+                continue;
+            }
+            if (!pc_collect(token, libs, depth + 1, visited, flags, count, capacity, files, files_len, files_capacity)) {
+                free(copy);
+                return false;
+            }
+        }
+        free(copy);
+    }
+    return true;
+}
+
+/*
+  @name pkg_config
+  @parameters char *library, bool libs
+  @description Cflags (or Libs) of a pkg-config package and everything it requires, without running pkg-config | Cached per run and across runs
+  @returns char * | NULL if the package or one of its requirements is missing | Owned by samba
 */
-void initialize_build_flags() {
-    // Modes
-    #ifdef S_RELEASE_MODE
-        add_flag("-O2");
-        add_flag("-DNDEBUG");
-        add_flag("-s");
-    #endif
+const char *pkg_config(const char *library, bool libs) {
+    char probe[512];
+    snprintf(probe, sizeof(probe), "pkg-config:%s:%s", libs ? "libs" : "cflags", library);
+
+    bool found;
+    const char *flags;
+    if (!probe_cache_get(probe, pc_search_key(), &found, &flags)) {
+        table_t visited = { 0 };
+        char **collected = NULL;
+        int count = 0, capacity = 0;
+        char *files = NULL;
+        size_t files_len = 0, files_capacity = 0;
+        command_append(&files, &files_len, &files_capacity, "%s", "");
+        found = pc_collect(library, libs, 0, &visited, &collected, &count, &capacity, &files, &files_len, &files_capacity);
+        table_clear(&visited, false);
+
+        // Cflags and -L keep their first occurrence; other libs keep their last so that
+        // every library still follows all of its users on the link line
+        char *joined = NULL;
+        size_t len = 0, joined_capacity = 0;
+        command_append(&joined, &len, &joined_capacity, "%s", "");
+        for (int i = 0; found && i < count; i++) {
+            bool keep = !pc_system_flag(collected[i]);
+            bool keep_last = libs && strncmp(collected[i], "-L", 2) != 0;
+            for (int j = keep_last ? i + 1 : 0; keep && j < (keep_last ? count : i); j++) {
+                if (strcmp(collected[i], collected[j]) == 0) keep = false;
+            }
+            if (keep) command_append(&joined, &len, &joined_capacity, "%s%s", len ? " " : "", collected[i]);
+        }
+        for (int i = 0; i < count; i++) free(collected[i]);
+        free(collected);
 
-    #ifdef S_DEBUG_MODE
-        add_flag("-O0");
-        add_flag("-g");
-    #endif
+        flags = probe_cache_put(probe, pc_search_key(), found, joined, files);
+        free(joined);
+        free(files);
+    }
 
-    // Integrate Samba Vars to the output executable
-    define_variable("S_VERSION", S_VERSION);
-    define_variable("S_COMPILER", S_COMPILER);
+    return found ? flags : NULL;
 }
 
 /*
   @name find_library
   @parameters char *library
-  @description Finds libs for the given library using pkg-config
-  @returns char *
+  @description Finds libs for the given library from its pkg-config file
+  @returns char * | NULL if the package is missing
 */
 char *find_library(const char *library) {
-    char command[256];
-    snprintf(command, sizeof(command), "pkg-config --libs %s", library);
-    FILE *pipe = popen(command, "r");
-    if (!pipe) return NULL;
-
-    char *result = malloc(128);
-    fgets(result, 128, pipe);
-    pclose(pipe);
-    return result;
+    const char *libs = pkg_config(library, true);
+    return libs ? strdup(libs) : NULL;
 }
 
 /*
   @name find_flags
   @parameters char *library
-  @description Finds flags for the given library using pkg-config
-  @returns char *
+  @description Finds flags for the given library from its pkg-config file
+  @returns char * | NULL if the package is missing
 */
 char *find_flags(const char *library) {
-    char command[256];
-    snprintf(command, sizeof(command), "pkg-config --cflags %s", library);
-    FILE *pipe = popen(command, "r");
-    if (!pipe) return NULL;
-
-    char *result = malloc(128);
-    fgets(result, 128, pipe);
-    pclose(pipe);
-    return result;
+    const char *cflags = pkg_config(library, false);
+    return cflags ? strdup(cflags) : NULL;
 }
 
 /*
@@ -1008,13 +3029,381 @@ pid_t get_process_id() {
 /*
   @name check_library
   @parameters char *library
-  @description Checks if a library is installed using pkg-config
+  @description Checks if a library is installed using its pkg-config file
   @returns bool
 */
 bool check_library(const char *library) {
-    char command[256];
-    snprintf(command, sizeof(command), "pkg-config --exists %s > /dev/null 2>&1", library);
-    return (system(command) == 0);
+    return pkg_config(library, false) != NULL;
+}
+
+// -- Parallel Probes --
+// Probes are submitted as one batch and spread over a pool of threads; each result is written
+// back into its own slot, so the outcome does not depend on scheduling.
+typedef enum {
+    PROBE_TOOL,          // found: tool is on PATH | value: its absolute path
+    PROBE_LIBRARY,       // found: pkg-config package exists | value: its cflags
+    PROBE_LIBS,          // found: pkg-config package exists | value: its libs
+    PROBE_COMPILE,       // found: source compiles with flags
+    PROBE_LINK,          // found: source compiles and links with flags
+} probe_kind_t;
+
+typedef struct {
+    probe_kind_t kind;
+    const char *name;
+    bool found;
+    const char *value;   // owned by samba
+    const char *source;  // PROBE_COMPILE / PROBE_LINK only
+    const char *flags;   // PROBE_COMPILE / PROBE_LINK only, may be NULL
+} probe_t;
+
+bool try_compile(const char *source, const char *flags, bool link);
+
+typedef struct {
+    probe_t *probes;
+    int count;
+    int next;
+    pthread_mutex_t mutex;
+} probe_batch_t;
+
+static void run_probe(probe_t *probe) {
+    switch (probe->kind) {
+        case PROBE_TOOL:
+            probe->value = which_tool(probe->name);
+            break;
+        case PROBE_LIBRARY:
+            probe->value = pkg_config(probe->name, false);
+            break;
+        case PROBE_LIBS:
+            probe->value = pkg_config(probe->name, true);
+            break;
+        case PROBE_COMPILE:
+        case PROBE_LINK:
+            probe->value = try_compile(probe->source, probe->flags, probe->kind == PROBE_LINK) ? "1" : NULL;
+            break;
+    }
+    probe->found = probe->value != NULL;
+}
+
+static void *probe_thread(void *arg) {
+    probe_batch_t *batch = arg;
+    for (;;) {
+        pthread_mutex_lock(&batch->mutex);
+        int index = batch->next++;
+        pthread_mutex_unlock(&batch->mutex);
+        if (index >= batch->count) return NULL;
+        run_probe(&batch->probes[index]);
+    }
+}
+
+/*
+  @name run_probes
+  @parameters probe_t *probes, int count, int jobs
+  @description Runs all probes concurrently on up to jobs threads (<= 0: one per CPU) and waits for them
+  @returns int | number of probes that were not found
+*/
+int run_probes(probe_t *probes, int count, int jobs) {
+    if (jobs <= 0) jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > count) jobs = count;
+
+    probe_batch_t batch = { .probes = probes, .count = count, .next = 0 };
+    pthread_mutex_init(&batch.mutex, NULL);
+
+    // The calling thread is one of the jobs and also picks up whatever the pool did not take
+    pthread_t threads[jobs > 1 ? jobs - 1 : 1];
+    int started = 0;
+    while (started < jobs - 1 && pthread_create(&threads[started], NULL, probe_thread, &batch) == 0) started++;
+    probe_thread(&batch);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&batch.mutex);
+
+    int missing = 0;
+    for (int i = 0; i < count; i++) missing += !probes[i].found;
+    return missing;
+}
+
+// -- Feature Checks --
+// Compiler and library features are detected by compiling (and optionally linking) small snippets.
+// Results go to the probe cache and can be written to a config header, which is only rewritten
+// when one of its values changed so that it does not trigger full rebuilds.
+typedef struct {
+    char *name;
+    char *value;         // NULL for #undef
+} config_define_t;
+
+static config_define_t *config_defines = NULL;
+static size_t num_config_defines = 0;
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Directories the compiler searches for <headers> and -l libraries, one per line. Only needed when a
+// probe actually runs, so they are not cached.
+static char *compiler_include_dirs = NULL;
+static char *compiler_library_dirs = NULL;
+static pthread_once_t search_dirs_once = PTHREAD_ONCE_INIT;
+
+static void search_dir_append(char **dirs, size_t *len, size_t *capacity, const char *dir, size_t dir_len) {
+    char path[PATH_MAX], resolved[PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s", (int)dir_len, dir);
+    if (!realpath(path, resolved)) return;
+    size_t resolved_len = strlen(resolved);
+    for (const char *line = *dirs; *line; line += strcspn(line, "\n") + 1) {
+        if (strcspn(line, "\n") == resolved_len && strncmp(line, resolved, resolved_len) == 0) return;
+    }
+    command_append(dirs, len, capacity, "%s\n", resolved);
+}
+
+static void compute_search_dirs() {
+    const char *command = compiler_command();
+    size_t include_len = 0, include_capacity = 0, library_len = 0, library_capacity = 0;
+    command_append(&compiler_include_dirs, &include_len, &include_capacity, "%s", "");
+    command_append(&compiler_library_dirs, &library_len, &library_capacity, "%s", "");
+
+    char *line = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&line, &len, &capacity, "%s -x c -E -v /dev/null", command);
+    char *output = capture_command(line);
+    bool search_list = false;
+    char *save = NULL;
+    for (char *row = output ? strtok_r(output, "\n", &save) : NULL; row; row = strtok_r(NULL, "\n", &save)) {
+        if (strncmp(row, "#include ", 9) == 0 && strstr(row, "search starts here")) search_list = true;
+        else if (strncmp(row, "End of search list", 18) == 0) search_list = false;
+        else if (search_list && row[0] == ' ') search_dir_append(&compiler_include_dirs, &include_len, &include_capacity, row + 1, strcspn(row + 1, " "));
+    }
+    free(output);
+
+    len = 0;
+    command_append(&line, &len, &capacity, "%s -print-search-dirs", command);
+    output = capture_command(line);
+    free(line);
+    save = NULL;
+    for (char *row = output ? strtok_r(output, "\n", &save) : NULL; row; row = strtok_r(NULL, "\n", &save)) {
+        if (strncmp(row, "libraries: =", 12) != 0) continue;
+        for (char *dir = row + 12; *dir; dir += strcspn(dir, ":") + (dir[strcspn(dir, ":")] ? 1 : 0)) {
+            search_dir_append(&compiler_library_dirs, &library_len, &library_capacity, dir, strcspn(dir, ":"));
+        }
+    }
+    free(output);
+}
+
+// Adds dir and, for every <a/b.h> the source includes, dir/a: installing a header or library adds
+// an entry to one of these directories and so changes its mtime
+static void try_compile_dir_inputs(const char *dir, size_t dir_len, const char *source, char **inputs, size_t *len, size_t *capacity) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%.*s", (int)dir_len, dir);
+    probe_input(inputs, len, capacity, path);
+    for (const char *include = strstr(source, "#include <"); include; include = strstr(include + 1, "#include <")) {
+        const char *name = include + 10;
+        const char *end = name + strcspn(name, ">\n");
+        const char *slash = end;
+        while (slash > name && *slash != '/') slash--;
+        if (slash == name) continue;
+        snprintf(path, sizeof(path), "%.*s/%.*s", (int)dir_len, dir, (int)(slash - name), name);
+        probe_input(inputs, len, capacity, path);
+    }
+}
+
+// What a try_compile result depends on besides the compiler: the header search path for compiles,
+// the library search path for links, and -I/-L directories from flags
+static void try_compile_inputs(const char *source, const char *flags, bool link, char **inputs, size_t *len, size_t *capacity) {
+    pthread_once(&search_dirs_once, compute_search_dirs);
+    const char *lists[2] = { compiler_include_dirs, link ? compiler_library_dirs : "" };
+    for (int i = 0; i < 2; i++) {
+        for (const char *dir = lists[i]; *dir; dir += strcspn(dir, "\n") + 1) {
+            try_compile_dir_inputs(dir, strcspn(dir, "\n"), i == 0 ? source : "", inputs, len, capacity);
+        }
+    }
+    for (const char *word = flags; *word; ) {
+        word += strspn(word, " ");
+        size_t word_len = strcspn(word, " ");
+        if (word_len > 2 && (strncmp(word, "-I", 2) == 0 || (link && strncmp(word, "-L", 2) == 0))) {
+            try_compile_dir_inputs(word + 2, word_len - 2, word[1] == 'I' ? source : "", inputs, len, capacity);
+        }
+        word += word_len;
+    }
+}
+
+/*
+  @name try_compile
+  @parameters char *source, char *flags, bool link
+  @description Checks if source compiles (and links, if link is set) with flags | Cached per compiler across runs, until a search directory changes
+  @returns bool
+*/
+bool try_compile(const char *source, const char *flags, bool link) {
+    if (!flags) flags = "";
+
+    unsigned long long id = hash_bytes(source, strlen(source), 0);
+    id = hash_bytes(flags, strlen(flags) + 1, id);
+    id = hash_bytes(&link, sizeof(link), id);
+    char probe[64];
+    snprintf(probe, sizeof(probe), "try:%016llx", id);
+
+    bool found;
+    if (probe_cache_get(probe, probe_key(true), &found, NULL)) return found;
+
+    if (build_directory && !build_directory_exists(build_directory)) mkdir(build_directory, 0755);
+    static int counter = 0;
+    char source_path[PATH_MAX], output_path[PATH_MAX];
+    int n = __sync_fetch_and_add(&counter, 1);
+    snprintf(source_path, sizeof(source_path), "%s/.samba_try_%d_%d.c", build_directory ? build_directory : ".", (int)getpid(), n);
+    snprintf(output_path, sizeof(output_path), "%s/.samba_try_%d_%d.out", build_directory ? build_directory : ".", (int)getpid(), n);
+    if (!write_whole_file(source_path, source, strlen(source))) return false;
+
+    char *command = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&command, &len, &capacity, "%s %s %s -o %s %s > /dev/null 2>&1",
+                   compiler_command(), link ? "" : "-c", source_path, output_path, flags);
+    verbose_log("Trying: %s\n", command);
+    found = system(command) == 0;
+    free(command);
+    remove(source_path);
+    remove(output_path);
+
+    char *inputs = NULL;
+    len = capacity = 0;
+    command_append(&inputs, &len, &capacity, "%s", "");
+    try_compile_inputs(source, flags, link, &inputs, &len, &capacity);
+    probe_cache_put(probe, probe_key(true), found, "", inputs);
+    free(inputs);
+    return found;
+}
+
+// HAVE_<name> with every character that is not valid in a macro replaced by '_'
+static void config_macro_name(char *out, size_t size, const char *prefix, const char *name) {
+    size_t len = snprintf(out, size, "%s%s", prefix, name);
+    for (size_t i = 0; i < len && i < size; i++) {
+        unsigned char c = out[i];
+        out[i] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) ? c : '_';
+    }
+}
+
+/*
+  @name config_define
+  @parameters char *name, char *value
+  @description Sets a macro for the config header (value NULL writes an #undef)
+  @returns void
+*/
+void config_define(const char *name, const char *value) {
+    pthread_mutex_lock(&config_mutex);
+    config_define_t *define = NULL;
+    for (size_t i = 0; i < num_config_defines && !define; i++) {
+        if (strcmp(config_defines[i].name, name) == 0) define = &config_defines[i];
+    }
+    if (!define) {
+        config_define_t *temp = realloc(config_defines, (num_config_defines + 1) * sizeof(config_define_t));
+        if (!temp) exit_error(__func__, "Out of memory");
+        config_defines = temp;
+        define = &config_defines[num_config_defines++];
+        define->name = strdup(name);
+    } else {
+        free(define->value);
+    }
+    define->value = value ? strdup(value) : NULL;
+    pthread_mutex_unlock(&config_mutex);
+}
+
+/*
+  @name check_features
+  @parameters probe_t *probes, int count
+  @description Runs compile/link probes concurrently and defines each probe name as 1 (or #undef) in the config header
+  @returns int | number of features not found
+*/
+int check_features(probe_t *probes, int count) {
+    int missing = run_probes(probes, count, 0);
+    for (int i = 0; i < count; i++) {
+        config_define(probes[i].name, probes[i].found ? "1" : NULL);
+    }
+    return missing;
+}
+
+/*
+  @name have_header
+  @parameters char *header
+  @description Checks if header can be included | Defines HAVE_<HEADER> (e.g. HAVE_SYS_EPOLL_H)
+  @returns bool
+*/
+bool have_header(const char *header) {
+    char source[PATH_MAX + 64], macro[PATH_MAX];
+    snprintf(source, sizeof(source), "#include <%s>\nint main(void) { return 0; }\n", header);
+    config_macro_name(macro, sizeof(macro), "HAVE_", header);
+    bool found = try_compile(source, NULL, false);
+    config_define(macro, found ? "1" : NULL);
+    return found;
+}
+
+/*
+  @name have_builtin
+  @parameters char *expression, char *macro
+  @description Checks if an expression such as "__builtin_popcount(1u)" compiles and links | Defines macro
+  @returns bool
+*/
+bool have_builtin(const char *expression, const char *macro) {
+    char *source = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&source, &len, &capacity, "int main(void) { (void)(%s); return 0; }\n", expression);
+    bool found = try_compile(source, NULL, true);
+    free(source);
+    config_define(macro, found ? "1" : NULL);
+    return found;
+}
+
+/*
+  @name have_library
+  @parameters char *library
+  @description Checks if -l<library> links | Defines HAVE_LIB<LIBRARY>
+  @returns bool
+*/
+bool have_library(const char *library) {
+    char flags[PATH_MAX], macro[PATH_MAX];
+    snprintf(flags, sizeof(flags), "-l%s", library);
+    config_macro_name(macro, sizeof(macro), "HAVE_LIB", library);
+    bool found = try_compile("int main(void) { return 0; }\n", flags, true);
+    config_define(macro, found ? "1" : NULL);
+    return found;
+}
+
+static int compare_config_defines(const void *a, const void *b) {
+    return strcmp(((const config_define_t *)a)->name, ((const config_define_t *)b)->name);
+}
+
+/*
+  @name write_config_header
+  @parameters char *path
+  @description Writes all config_define values to path | The file is left untouched if its content would not change
+  @returns int | 1 if the file was written, 0 if it was up to date, S_ERROR on failure
+*/
+int write_config_header(const char *path) {
+    pthread_mutex_lock(&config_mutex);
+    qsort(config_defines, num_config_defines, sizeof(config_define_t), compare_config_defines);
+
+    char *content = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&content, &len, &capacity, "// Generated by samba, do not edit\n#ifndef SAMBA_CONFIG_H\n#define SAMBA_CONFIG_H\n\n");
+    for (size_t i = 0; i < num_config_defines; i++) {
+        if (config_defines[i].value) command_append(&content, &len, &capacity, "#define %s %s\n", config_defines[i].name, config_defines[i].value);
+        else command_append(&content, &len, &capacity, "/* #undef %s */\n", config_defines[i].name);
+    }
+    command_append(&content, &len, &capacity, "\n#endif\n");
+    pthread_mutex_unlock(&config_mutex);
+
+    size_t old_len;
+    char *old = read_whole_file(path, &old_len);
+    bool unchanged = old && old_len == len && memcmp(old, content, len) == 0;
+    free(old);
+    if (unchanged) {
+        free(content);
+        return 0;
+    }
+
+    char temp[PATH_MAX + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    bool written = write_whole_file(temp, content, len) && rename(temp, path) == 0;
+    free(content);
+    if (!written) {
+        remove(temp);
+        fprintf(stderr, "Error: could not write '%s'\n", path);
+        return S_ERROR;
+    }
+    verbose_log("Config header '%s' updated\n", path);
+    return 1;
 }
 
 /*
@@ -1212,8 +3601,18 @@ void install_dependency(char *tool) {
 }
 
 bool check_dependencies(char **dependencies, int dependencies_count, bool print, bool install_if_not_find) {
+    if (dependencies_count <= 0) return true;
+
+    probe_t *probes = calloc(dependencies_count, sizeof(probe_t));
+    if (!probes) exit_error(__func__, "Out of memory");
+    for (int i = 0; i < dependencies_count; i++) {
+        probes[i].kind = PROBE_LIBRARY;
+        probes[i].name = dependencies[i];
+    }
+    bool all_found = run_probes(probes, dependencies_count, 0) == 0;
+
     for (int i = 0; i < dependencies_count; i++) {
-        if (!check_library(dependencies[i])) {
+        if (!probes[i].found) {
             if (print) printf("'%s' not found.\n", dependencies[i]);
             if (install_if_not_find) install_dependency(dependencies[i]);
         }
@@ -1221,6 +3620,8 @@ bool check_dependencies(char **dependencies, int dependencies_count, bool print,
             if (print) printf("| '%s' found.\n", dependencies[i]);
         }
     }
+    free(probes);
+    return all_found;
 }
 
 void save_git_log_to_file(char *file_path) {
@@ -1348,6 +3749,596 @@ void print_flags() {
     }
 }
 
+// -- Partial Linking --
+// Objects are split into groups at content-defined boundaries (a member whose path hashes to a
+// multiple of S_PARTIAL_LINK_GROUP ends its group), so adding or removing an object only changes
+// the group it falls into. A group whose members were unchanged over two runs is merged with
+// `<compiler> -r -nostdlib` into a relocatable object cached by the hash of its members.
+#ifndef S_PARTIAL_LINK_GROUP
+    #define S_PARTIAL_LINK_GROUP 64
+#endif
+
+typedef struct {
+    char *path;
+    long long mtime;
+    long long size;
+    unsigned long long hash;
+} object_state_t;
+
+static object_state_t *object_states = NULL;
+static size_t num_object_states = 0;
+
+static long long file_mtime_ns(const struct stat *info) {
+#if defined(__APPLE__)
+    return (long long)info->st_mtimespec.tv_sec * 1000000000 + info->st_mtimespec.tv_nsec;
+#else
+    return (long long)info->st_mtim.tv_sec * 1000000000 + info->st_mtim.tv_nsec;
+#endif
+}
+
+static int compare_object_states(const void *a, const void *b) {
+    return strcmp(((const object_state_t *)a)->path, ((const object_state_t *)b)->path);
+}
+
+static char *partial_link_path(const char *name) {
+    static char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/.partial/%s", build_directory ? build_directory : ".", name);
+    return path;
+}
+
+static void load_object_states() {
+    if (object_states) return;
+    FILE *file = fopen(partial_link_path("objects"), "r");
+    if (!file) return;
+
+    char line[PATH_MAX + 128];
+    while (fgets(line, sizeof(line), file)) {
+        long long mtime, size;
+        unsigned long long hash;
+        int path_at = 0;
+        if (sscanf(line, "%lld %lld %llx %n", &mtime, &size, &hash, &path_at) != 3 || !path_at) continue;
+        line[strcspn(line, "\n")] = '\0';
+
+        object_states = realloc(object_states, sizeof(object_state_t) * (num_object_states + 1));
+        if (!object_states) exit_error(__func__, "Out of memory");
+        object_states[num_object_states].path = strdup(line + path_at);
+        object_states[num_object_states].mtime = mtime;
+        object_states[num_object_states].size = size;
+        object_states[num_object_states].hash = hash;
+        num_object_states++;
+    }
+    fclose(file);
+    qsort(object_states, num_object_states, sizeof(object_state_t), compare_object_states);
+}
+
+/*
+  @name object_hash
+  @parameters char *path, unsigned long long *hash
+  @description Content hash of an object, only rehashed when its mtime (in nanoseconds) or size moved
+  @returns bool
+*/
+bool object_hash(const char *path, unsigned long long *hash) {
+    struct stat info;
+    if (stat(path, &info) != 0) return false;
+
+    load_object_states();
+    object_state_t key = { .path = (char *)path };
+    object_state_t *state = NULL;
+    if (num_object_states) {
+        state = bsearch(&key, object_states, num_object_states, sizeof(object_state_t), compare_object_states);
+    }
+    long long mtime = file_mtime_ns(&info);
+    if (state && state->mtime == mtime && state->size == (long long)info.st_size) {
+        *hash = state->hash;
+        return true;
+    }
+
+    if (!hash_file(path, hash)) return false;
+    if (state) {
+        state->mtime = mtime;
+        state->size = info.st_size;
+        state->hash = *hash;
+    } else {
+        object_states = realloc(object_states, sizeof(object_state_t) * (num_object_states + 1));
+        if (!object_states) exit_error(__func__, "Out of memory");
+        object_states[num_object_states].path = strdup(path);
+        object_states[num_object_states].mtime = mtime;
+        object_states[num_object_states].size = info.st_size;
+        object_states[num_object_states].hash = *hash;
+        num_object_states++;
+        qsort(object_states, num_object_states, sizeof(object_state_t), compare_object_states);
+    }
+    return true;
+}
+
+static void save_object_states() {
+    FILE *file = fopen(partial_link_path("objects"), "w");
+    if (!file) return;
+    for (size_t i = 0; i < num_object_states; i++) {
+        fprintf(file, "%lld %lld %016llx %s\n", object_states[i].mtime, object_states[i].size,
+                object_states[i].hash, object_states[i].path);
+    }
+    fclose(file);
+}
+
+// Whether the objects are linked with LTO; relocatable links of LTO objects would lose the IR
+static bool link_uses_lto() {
+    for (size_t i = 0; i < num_flags; i++) {
+        if (strncmp(flags[i], "-flto", 5) == 0) return true;
+        if (strcmp(flags[i], "-fno-lto") == 0) return false;
+    }
+    return false;
+}
+
+// Merges objects into partial with the configured compiler and linker
+static bool partial_link(char **objects, int count, const char *partial) {
+    char *command = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&command, &len, &capacity, "%s -r -nostdlib", compiler_command());
+    // --gdb-index is left to the final link, linkers reject it together with -r
+    if (toolchain.probed && toolchain.linker[0]) command_append(&command, &len, &capacity, " -fuse-ld=%s", toolchain.linker);
+    command_append(&command, &len, &capacity, " -o %s", partial);
+    for (int i = 0; i < count; i++) command_append(&command, &len, &capacity, " %s", objects[i]);
+    verbose_log("Executing command: %s\n", command);
+    bool ok = system(command) == 0;
+    free(command);
+    if (!ok) remove(partial);
+    return ok;
+}
+
+/*
+  @name link_objects
+  @parameters char **objects, int num_objects, char *output_file, bool create_shared
+  @description Links objects into output_file, reusing cached partial links for groups that did not change | Used by the link/link_s verbs of build.samba
+  @returns int
+*/
+int link_objects(char **objects, int num_objects, const char *output_file, bool create_shared) {
+    if (!make_directories(partial_link_path(""))) {
+        exit_error(__func__, "Failed to create partial link directory");
+    }
+
+    // Group keys of the previous run; a group is only merged once it has been seen twice
+    char groups_file[PATH_MAX];
+    snprintf(groups_file, sizeof(groups_file), "%s", partial_link_path("groups"));
+    table_t previous = { 0 }, current = { 0 };
+    FILE *file = fopen(groups_file, "r");
+    if (file) {
+        char key[32];
+        while (fscanf(file, "%31s", key) == 1) *table_put(&previous, key) = (void *)1;
+        fclose(file);
+    }
+
+    bool lto = link_uses_lto();
+    if (lto) verbose_log("LTO enabled, not using partial links\n");
+
+    char *inputs = NULL;
+    size_t inputs_len = 0, inputs_capacity = 0;
+    int merged = 0;
+    file = fopen(groups_file, "w");
+
+    for (int first = 0; first < num_objects; ) {
+        int last = first;
+        unsigned long long key = 0;
+        bool hashed = true;
+        while (last < num_objects) {
+            const char *path = objects[last++];
+            unsigned long long hash = 0;
+            if (!object_hash(path, &hash)) hashed = false;
+            key = hash_bytes(path, strlen(path) + 1, key);
+            key = hash_bytes(&hash, sizeof(hash), key);
+            if (hash_bytes(path, strlen(path), 0) % S_PARTIAL_LINK_GROUP == 0 || last - first >= 4 * S_PARTIAL_LINK_GROUP) break;
+        }
+
+        char group[32], name[32], partial[PATH_MAX];
+        snprintf(group, sizeof(group), "%016llx", key);
+        snprintf(name, sizeof(name), "%s.o", group);
+        snprintf(partial, sizeof(partial), "%s", partial_link_path(name));
+        bool mergeable = hashed && !lto && last - first > 1;
+        if (mergeable) {
+            if (file) fprintf(file, "%s\n", group);
+            *table_put(&current, group) = (void *)1;
+            if (!file_exists(partial) && table_get(&previous, group)) partial_link(objects + first, last - first, partial);
+        }
+
+        if (mergeable && file_exists(partial)) {
+            command_append(&inputs, &inputs_len, &inputs_capacity, "%s\n", partial);
+            merged++;
+        } else {
+            for (int i = first; i < last; i++) command_append(&inputs, &inputs_len, &inputs_capacity, "%s\n", objects[i]);
+        }
+        first = last;
+    }
+    if (file) fclose(file);
+
+    // Partial links of groups that no longer exist
+    for (size_t i = 0; i < previous.capacity; i++) {
+        const char *key = previous.entries[i].key;
+        if (!key || table_get(&current, key)) continue;
+        char name[32];
+        snprintf(name, sizeof(name), "%s.o", key);
+        remove(partial_link_path(name));
+    }
+    table_clear(&previous, false);
+    table_clear(&current, false);
+    save_object_states();
+
+    // Inputs go through a response file so thousands of objects don't hit the argument limit
+    char response_file[PATH_MAX];
+    snprintf(response_file, sizeof(response_file), "%s", partial_link_path("link.rsp"));
+    file = fopen(response_file, "w");
+    if (!file) exit_error(__func__, "Failed to write response file");
+    if (inputs) fputs(inputs, file);
+    fclose(file);
+    free(inputs);
+
+    char *command = NULL;
+    size_t len = 0, capacity = 0;
+    command_append(&command, &len, &capacity, "%s", compiler_command());
+    for (size_t i = 0; i < num_flags; i++) command_append(&command, &len, &capacity, " %s", flags[i]);
+    if (create_shared) command_append(&command, &len, &capacity, " -shared");
+    command_append(&command, &len, &capacity, " %s", toolchain_link_flags());
+    if (build_directory == NULL) command_append(&command, &len, &capacity, " -o %s", output_file);
+    else command_append(&command, &len, &capacity, " -o %s/%s", build_directory, output_file);
+    command_append(&command, &len, &capacity, " @%s", response_file);
+    for (size_t i = 0; i < num_library_paths; i++) command_append(&command, &len, &capacity, " -L%s", library_paths[i].key);
+    for (size_t i = 0; i < num_libraries; i++) command_append(&command, &len, &capacity, " -l%s", libraries[i].key);
+
+    verbose_log("Linking %d objects (%d cached partial links)\n", num_objects, merged);
+    verbose_log("Executing command: %s\n", command);
+    int result = system(command);
+    free(command);
+
+    if (result != 0) {
+        fprintf(stderr, "Error: Linking failed.\n");
+        return S_ERROR;
+    }
+    printf("Linking successful: %s\n", output_file);
+    return 0;
+}
+
+
+
+
+// -- Archives --
+// Writes GNU static libraries without an external ar. Output matches `ar rcsD`: members are
+// replaced or appended by file name, timestamps and owners are zero and the `/` symbol table is
+// rebuilt from the members' ELF symbols.
+#define ARCHIVE_MAGIC "!<arch>\n"
+#define ARCHIVE_HEADER_LEN 60
+
+typedef struct {
+    char *name;
+    const unsigned char *data;
+    size_t size;
+    long offset;  // where the data starts in the existing archive, -1 for new members
+    bool changed;
+} archive_member_t;
+
+typedef struct {
+    const char *name;
+    size_t member;
+} archive_symbol_t;
+
+static unsigned long long elf_read(const unsigned char *p, int width, bool big) {
+    unsigned long long value = 0;
+    for (int i = 0; i < width; i++) value |= (unsigned long long)p[i] << (big ? (width - 1 - i) * 8 : i * 8);
+    return value;
+}
+
+// Global symbols an ELF relocatable defines, the same set `ar s` indexes
+static void archive_elf_symbols(const unsigned char *data, size_t size, size_t member,
+                                archive_symbol_t **symbols, size_t *count, size_t *capacity) {
+    if (size < 16 || memcmp(data, "\x7f" "ELF", 4) != 0) return;
+    bool is64 = data[4] == 2;
+    bool big = data[5] == 2;
+    if (size < (is64 ? 64 : 52)) return; // ELF header
+    if (elf_read(data + 16, 2, big) != 1) return; // ET_REL
+
+    unsigned long long shoff = is64 ? elf_read(data + 40, 8, big) : elf_read(data + 32, 4, big);
+    unsigned long long shentsize = elf_read(data + (is64 ? 58 : 46), 2, big);
+    unsigned long long shnum = elf_read(data + (is64 ? 60 : 48), 2, big);
+    if (shoff == 0 || shnum == 0 || shentsize < (is64 ? 64 : 40)) return;
+    if (shoff > size || shentsize * shnum > size - shoff) return;
+
+    for (unsigned long long i = 0; i < shnum; i++) {
+        const unsigned char *sh = data + shoff + i * shentsize;
+        if (elf_read(sh + 4, 4, big) != 2) continue; // SHT_SYMTAB
+
+        unsigned long long sym_off = is64 ? elf_read(sh + 24, 8, big) : elf_read(sh + 16, 4, big);
+        unsigned long long sym_size = is64 ? elf_read(sh + 32, 8, big) : elf_read(sh + 20, 4, big);
+        unsigned long long link = elf_read(sh + (is64 ? 40 : 24), 4, big);
+        unsigned long long entsize = is64 ? elf_read(sh + 56, 8, big) : elf_read(sh + 36, 4, big);
+        if (link >= shnum || entsize < (is64 ? 24 : 16) || sym_off > size || sym_size > size - sym_off) continue;
+        if (link * shentsize > size - shoff - shentsize) continue;
+
+        const unsigned char *str_sh = data + shoff + link * shentsize;
+        unsigned long long str_off = is64 ? elf_read(str_sh + 24, 8, big) : elf_read(str_sh + 16, 4, big);
+        unsigned long long str_size = is64 ? elf_read(str_sh + 32, 8, big) : elf_read(str_sh + 20, 4, big);
+        if (str_off > size || str_size > size - str_off || str_size == 0) continue;
+        const char *strtab = (const char *)data + str_off;
+
+        for (unsigned long long s = 1; s < sym_size / entsize; s++) {
+            const unsigned char *sym = data + sym_off + s * entsize;
+            unsigned long long name = elf_read(sym, 4, big);
+            int bind = (is64 ? sym[4] : sym[12]) >> 4;
+            unsigned long long shndx = elf_read(sym + (is64 ? 6 : 14), 2, big);
+            if (bind != 1 && bind != 2 && bind != 10) continue; // GLOBAL, WEAK, GNU_UNIQUE
+            if (shndx == 0 || name == 0 || name >= str_size) continue;
+            if (!memchr(strtab + name, '\0', str_size - name)) continue;
+
+            if (*count == *capacity) {
+                *capacity = *capacity ? *capacity * 2 : 64;
+                *symbols = realloc(*symbols, sizeof(archive_symbol_t) * *capacity);
+                if (!*symbols) exit_error(__func__, "Out of memory");
+            }
+            (*symbols)[(*count)++] = (archive_symbol_t){ .name = strtab + name, .member = member };
+        }
+    }
+}
+
+// Reads the members and symbol table of an existing archive; returns false if it is not one
+static bool archive_parse(const unsigned char *data, size_t size, archive_member_t **members, size_t *count,
+                          const unsigned char **symtab, size_t *symtab_size) {
+    if (size < 8 || memcmp(data, ARCHIVE_MAGIC, 8) != 0) return false;
+    const char *longnames = NULL;
+    size_t longnames_size = 0;
+    size_t pos = 8;
+
+    while (pos + ARCHIVE_HEADER_LEN <= size) {
+        const char *header = (const char *)data + pos;
+        if (header[58] != '`' || header[59] != '\n') return false;
+        char size_field[11];
+        memcpy(size_field, header + 48, 10);
+        size_field[10] = '\0';
+        size_t member_size = strtoul(size_field, NULL, 10);
+        size_t data_pos = pos + ARCHIVE_HEADER_LEN;
+        if (member_size > size - data_pos) return false;
+
+        if (memcmp(header, "/ ", 2) == 0) {
+            *symtab = data + data_pos;
+            *symtab_size = member_size;
+        } else if (memcmp(header, "// ", 3) == 0) {
+            longnames = (const char *)data + data_pos;
+            longnames_size = member_size;
+        } else if (memcmp(header, "/SYM64/", 7) != 0) {
+            char *name;
+            if (header[0] == '/' && header[1] >= '0' && header[1] <= '9') {
+                size_t offset = strtoul(header + 1, NULL, 10);
+                if (!longnames || offset >= longnames_size) return false;
+                size_t len = strcspn(longnames + offset, "/\n");
+                if (len > longnames_size - offset) len = longnames_size - offset;
+                name = strndup(longnames + offset, len);
+            } else {
+                size_t len = 16;
+                while (len > 0 && header[len - 1] == ' ') len--;
+                if (len > 0 && header[len - 1] == '/') len--;
+                name = strndup(header, len);
+            }
+            *members = realloc(*members, sizeof(archive_member_t) * (*count + 1));
+            if (!*members || !name) exit_error(__func__, "Out of memory");
+            (*members)[(*count)++] = (archive_member_t){ .name = name, .data = data + data_pos, .size = member_size,
+                                                         .offset = (long)data_pos };
+        }
+        pos = data_pos + member_size + (member_size & 1);
+    }
+    return true;
+}
+
+static bool archive_long_name(const char *name) {
+    return strlen(name) > 15 || strchr(name, ' ') || strchr(name, '/');
+}
+
+// Space-padded header fields, written with memcpy since they are not NUL-terminated
+static void archive_header(FILE *file, const char *name, size_t size, const char *mode) {
+    char header[ARCHIVE_HEADER_LEN];
+    char size_field[24];
+    snprintf(size_field, sizeof(size_field), "%zu", size);
+    const char *fields[] = { name, "0", "0", "0", mode, size_field };
+    const size_t widths[] = { 16, 12, 6, 6, 8, 10 };
+    char *out = header;
+    for (int i = 0; i < 6; i++) {
+        size_t len = strlen(fields[i]);
+        memset(out, ' ', widths[i]);
+        memcpy(out, fields[i], len < widths[i] ? len : widths[i]);
+        out += widths[i];
+    }
+    out[0] = '`';
+    out[1] = '\n';
+    if (strcmp(name, "//") == 0) memset(header + 16, ' ', 32); // GNU leaves date/uid/gid/mode blank here
+    fwrite(header, 1, ARCHIVE_HEADER_LEN, file);
+}
+
+static void archive_put32(unsigned char *out, unsigned long value) {
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+// Writes the changed members over their old data; only valid when no offset moves
+static bool archive_patch(const char *archive, archive_member_t *members, size_t num_members) {
+    FILE *file = fopen(archive, "r+b");
+    if (!file) return false;
+    for (size_t m = 0; m < num_members; m++) {
+        if (!members[m].changed) continue;
+        if (fseek(file, members[m].offset, SEEK_SET) != 0 ||
+            fwrite(members[m].data, 1, members[m].size, file) != members[m].size) {
+            fclose(file);
+            return false;
+        }
+    }
+    return fclose(file) == 0;
+}
+
+/*
+  @name create_archive
+  @parameters char *archive, char **objects, int num_objects
+  @description Adds or replaces objects in a static library (like `ar rcsD`) and rebuilds its symbol table | When
+               no member is added or resized and the symbol table comes out the same, the changed members are
+               written over their old data instead of rewriting the archive
+  @returns int
+*/
+int create_archive(const char *archive, char **objects, int num_objects) {
+    archive_member_t *members = NULL;
+    size_t num_members = 0;
+    size_t old_size = 0;
+    const unsigned char *old_symtab = NULL;
+    size_t old_symtab_size = 0;
+    char *old = read_whole_file(archive, &old_size);
+    if (old && !archive_parse((const unsigned char *)old, old_size, &members, &num_members, &old_symtab, &old_symtab_size)) {
+        fprintf(stderr, "Error: '%s' is not an archive.\n", archive);
+        free(old);
+        return S_ERROR;
+    }
+
+    int result = 0;
+    int changed = 0;
+    bool same_layout = true;
+    char **buffers = calloc(num_objects + 1, sizeof(char *));
+    if (!buffers) exit_error(__func__, "Out of memory");
+    for (int i = 0; i < num_objects; i++) {
+        size_t size;
+        buffers[i] = read_whole_file(objects[i], &size);
+        if (!buffers[i]) {
+            fprintf(stderr, "Error: Cannot read '%s'.\n", objects[i]);
+            result = S_ERROR;
+            goto done;
+        }
+        const char *slash = strrchr(objects[i], '/');
+        const char *name = slash ? slash + 1 : objects[i];
+
+        archive_member_t *member = NULL;
+        for (size_t m = 0; m < num_members && !member; m++) {
+            if (strcmp(members[m].name, name) == 0) member = &members[m];
+        }
+        if (member && member->size == size && memcmp(member->data, buffers[i], size) == 0) continue;
+        if (!member) {
+            members = realloc(members, sizeof(archive_member_t) * (num_members + 1));
+            if (!members) exit_error(__func__, "Out of memory");
+            member = &members[num_members++];
+            member->name = strdup(name);
+            member->offset = -1;
+            member->size = 0;
+        }
+        if (member->offset < 0 || member->size != size) same_layout = false;
+        member->data = (const unsigned char *)buffers[i];
+        member->size = size;
+        member->changed = true;
+        changed++;
+    }
+    if (old && changed == 0) {
+        verbose_log("Archive %s is up to date\n", archive);
+        goto done;
+    }
+
+    archive_symbol_t *symbols = NULL;
+    size_t num_symbols = 0, symbols_capacity = 0;
+    for (size_t m = 0; m < num_members; m++) {
+        archive_elf_symbols(members[m].data, members[m].size, m, &symbols, &num_symbols, &symbols_capacity);
+    }
+
+    size_t longnames_size = 0;
+    for (size_t m = 0; m < num_members; m++) {
+        if (archive_long_name(members[m].name)) longnames_size += strlen(members[m].name) + 2;
+    }
+    longnames_size += longnames_size & 1; // GNU counts the padding as part of the table
+
+    size_t symtab_size = 0;
+    if (num_symbols) {
+        symtab_size = 4 + 4 * num_symbols;
+        for (size_t s = 0; s < num_symbols; s++) symtab_size += strlen(symbols[s].name) + 1;
+        symtab_size += symtab_size & 1;
+    }
+    unsigned char *symtab = calloc(1, symtab_size + 1);
+    if (!symtab) exit_error(__func__, "Out of memory");
+
+    // Symbol offsets point at member headers, which follow the symbol and long-name tables
+    size_t *offsets = malloc(sizeof(size_t) * (num_members + 1));
+    if (!offsets) exit_error(__func__, "Out of memory");
+    size_t pos = 8 + (symtab_size ? ARCHIVE_HEADER_LEN + symtab_size : 0) +
+                 (longnames_size ? ARCHIVE_HEADER_LEN + longnames_size : 0);
+    for (size_t m = 0; m < num_members; m++) {
+        offsets[m] = pos;
+        pos += ARCHIVE_HEADER_LEN + members[m].size + (members[m].size & 1);
+    }
+    if (symtab_size) {
+        archive_put32(symtab, num_symbols);
+        unsigned char *out = symtab + 4 + 4 * num_symbols;
+        for (size_t s = 0; s < num_symbols; s++) {
+            archive_put32(symtab + 4 + 4 * s, offsets[symbols[s].member]);
+            size_t len = strlen(symbols[s].name) + 1;
+            memcpy(out, symbols[s].name, len);
+            out += len;
+        }
+    }
+
+    // Same sizes and an identical index leave every offset where it was: patch the data only
+    if (old && same_layout && symtab_size == old_symtab_size &&
+        (symtab_size == 0 || memcmp(symtab, old_symtab, symtab_size) == 0)) {
+        if (archive_patch(archive, members, num_members)) {
+            verbose_log("Updated %d member(s) of archive %s in place\n", changed, archive);
+            goto written;
+        }
+    }
+
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", archive);
+    FILE *file = fopen(temporary, "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot write '%s'.\n", temporary);
+        result = S_ERROR;
+    } else {
+        fwrite(ARCHIVE_MAGIC, 1, 8, file);
+        if (symtab_size) {
+            archive_header(file, "/", symtab_size, "0");
+            fwrite(symtab, 1, symtab_size, file);
+        }
+        if (longnames_size) {
+            archive_header(file, "//", longnames_size, "");
+            size_t written = 0;
+            for (size_t m = 0; m < num_members; m++) {
+                if (!archive_long_name(members[m].name)) continue;
+                fprintf(file, "%s/\n", members[m].name);
+                written += strlen(members[m].name) + 2;
+            }
+            if (written < longnames_size) fputc('\n', file);
+        }
+        size_t longname_offset = 0;
+        for (size_t m = 0; m < num_members; m++) {
+            char name[32];
+            if (archive_long_name(members[m].name)) {
+                snprintf(name, sizeof(name), "/%zu", longname_offset);
+                longname_offset += strlen(members[m].name) + 2;
+            } else {
+                snprintf(name, sizeof(name), "%.15s/", members[m].name);
+            }
+            archive_header(file, name, members[m].size, "644");
+            fwrite(members[m].data, 1, members[m].size, file);
+            if (members[m].size & 1) fputc('\n', file);
+        }
+        if (ferror(file) | fclose(file) || rename(temporary, archive) != 0) {
+            fprintf(stderr, "Error: Failed to write archive '%s'.\n", archive);
+            remove(temporary);
+            result = S_ERROR;
+        } else {
+            verbose_log("Wrote archive %s (%zu members, %zu symbols)\n", archive, num_members, num_symbols);
+        }
+    }
+written:
+    free(offsets);
+    free(symtab);
+    free(symbols);
+
+done:
+    for (size_t m = 0; m < num_members; m++) free(members[m].name);
+    free(members);
+    for (int i = 0; i < num_objects; i++) free(buffers[i]);
+    free(buffers);
+    free(old);
+    return result;
+}
+
+
 
 
 #ifdef S_CURLE
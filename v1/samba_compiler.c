@@ -66,9 +66,6 @@ StringArray* create_string_array(size_t initial_capacity) {
 
 void free_string_array(StringArray* array) {
     if (!array) return;
-    for (size_t i = 0; i < array->size; i++) {
-        free(array->data[i]);
-    }
     free(array->data);
     free(array);
 }
@@ -89,8 +86,8 @@ int append_to_string_array(StringArray* array, const char* str) {
         array->capacity = new_capacity;
     }
 
-    array->data[array->size] = strdup(str);
-    if (!array->data[array->size]) return -1;
+    // Arguments are mostly flags and paths seen before; they share the interned copy
+    array->data[array->size] = (char *)intern_string(str);
 
     array->size++;
     return 0;
@@ -252,6 +249,8 @@ void execute_function(const char* func_name, StringArray* args) {
         define_library_path(args->data[0]);
     } else if (strcmp(func_name, "add_flag") == 0 && args->size == 1) {
         add_flag(args->data[0]);
+    } else if (strcmp(func_name, "add_worker") == 0 && args->size == 1) {
+        add_worker(args->data[0]);
     } else if (strcmp(func_name, "compile") == 0 && args->size == 2) {
         compile(args->data[0], args->data[1], false);
     } else if (strcmp(func_name, "compile_s") == 0 && args->size == 2) {
@@ -274,6 +273,20 @@ void execute_function(const char* func_name, StringArray* args) {
         find_library(args->data[0]);
     } else if (strcmp(func_name, "find_flags") == 0 && args->size == 1) {
         find_flags(args->data[0]);
+    } else if (strcmp(func_name, "have_header") == 0 && args->size == 1) {
+        have_header(args->data[0]);
+    } else if (strcmp(func_name, "have_library") == 0 && args->size == 1) {
+        have_library(args->data[0]);
+    } else if (strcmp(func_name, "config_define") == 0 && args->size == 2) {
+        config_define(args->data[0], args->data[1]);
+    } else if (strcmp(func_name, "write_config_header") == 0 && args->size == 1) {
+        write_config_header(args->data[0]);
+    } else if (strcmp(func_name, "link") == 0 && args->size >= 2) {
+        link_objects(args->data + 1, (int)args->size - 1, args->data[0], false);
+    } else if (strcmp(func_name, "link_s") == 0 && args->size >= 2) {
+        link_objects(args->data + 1, (int)args->size - 1, args->data[0], true);
+    } else if (strcmp(func_name, "archive") == 0 && args->size >= 2) {
+        create_archive(args->data[0], args->data + 1, (int)args->size - 1);
     } else if (strcmp(func_name, "s_command") == 0 && args->size == 1) {
         s_command(args->data[0]);
     } else if (strcmp(func_name, "set_build_directory") == 0 && args->size == 1) {
@@ -425,6 +438,10 @@ int main(int argc, char* argv[]) {
         printf("| samba v%s\n", S_VERSION);
     } else if (argc == 2 && strcmp(argv[1], "--version_short") == 0) {
         printf("v3\n");
+    } else if (argc >= 2 && strcmp(argv[1], "--worker") == 0) {
+        // samba --worker [port] [slots] [address]; listens on 127.0.0.1 unless an address is given
+        if (argc >= 5) set_worker_address(argv[4]);
+        return run_worker(argc >= 3 ? atoi(argv[2]) : S_WORKER_PORT, argc >= 4 ? atoi(argv[3]) : 0);
     } else {
         clock_t start = clock();
         parse_build_file("build.samba", argc, argv, true);
@@ -0,0 +1,27 @@
+# Stand-in for a remote object cache: keeps PUT /ac/<key> and /cas/<digest> in memory and serves them on GET
+import sys
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+store = {}
+
+
+class Handler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        data = store.get(self.path)
+        self.send_response(200 if data is not None else 404)
+        self.send_header("Content-Length", str(len(data or b"")))
+        self.end_headers()
+        if data is not None:
+            self.wfile.write(data)
+
+    def do_PUT(self):
+        store[self.path] = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        self.send_response(201)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, *args):
+        pass
+
+
+HTTPServer(("127.0.0.1", int(sys.argv[1])), Handler).serve_forever()
@@ -11,5 +11,18 @@ int main() {
     else printf("| is_internet_available | not working ✖\n");
     if (!checkpoint_exists(999999999999)) printf("| checkpoint_exists     | working ✔\n");
     else printf("| checkpoint_exists     | not working ✖\n");
+    add_flag("-Wall"); add_flag("-Wall");
+    add_flag("-Wl,-Bstatic"); add_flag("-lfoo"); add_flag("-Wl,-Bdynamic"); add_flag("-Wl,-Bstatic"); add_flag("-lfoo");
+    if (num_flags == 6) printf("| add_flag              | working ✔\n");
+    else printf("| add_flag              | not working ✖\n");
+    define_library("a"); define_library("b"); define_library("a"); remove_library("b");
+    if (num_libraries == 2 && strcmp(libraries[0].key, "a") == 0 && strcmp(libraries[1].key, "a") == 0) printf("| define_library        | working ✔\n");
+    else printf("| define_library        | not working ✖\n");
+    char *large = malloc(70001);
+    memset(large, 'x', 70000); large[70000] = '\0';
+    const char *big = intern_string(large);
+    const char *small = intern_string("-Wextra");
+    if (big != large && strcmp(big, large) == 0 && intern_string("-Wextra") == small && intern_string(large) == big) printf("| intern_string         | working ✔\n");
+    else printf("| intern_string         | not working ✖\n");
+    free(large);
 }
-
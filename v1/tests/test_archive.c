@@ -0,0 +1,63 @@
+#include "../samba.h"
+
+// Compares create_archive with GNU `ar rcsD`; needs cc and ar on the PATH
+static bool same_file(const char *a, const char *b) {
+    size_t a_len, b_len;
+    char *a_data = read_whole_file(a, &a_len);
+    char *b_data = read_whole_file(b, &b_len);
+    bool same = a_data && b_data && a_len == b_len && memcmp(a_data, b_data, a_len) == 0;
+    free(a_data);
+    free(b_data);
+    return same;
+}
+
+static void report(const char *name, bool working) {
+    if (working) printf("| %-21s | working ✔\n", name);
+    else printf("| %-21s | not working ✖\n", name);
+}
+
+int main() {
+    char dir[] = "/tmp/samba-archive-test-XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) return 1;
+    printf("My lovely Archive Tests: 😍😘\n");
+
+    const char *alpha = "int alpha(void) { return 1; }\nint shared_counter;\n";
+    const char *beta = "static int hidden(void) { return 2; }\nint beta(void) { return hidden(); }\n";
+    write_whole_file("alpha.c", alpha, strlen(alpha));
+    write_whole_file("a_rather_long_member_name.c", beta, strlen(beta));
+    if (system("cc -c alpha.c a_rather_long_member_name.c") != 0) return 1;
+
+    char *objects[] = { "alpha.o", "a_rather_long_member_name.o", "truncated.o" };
+    create_archive("mine.a", objects, 2);
+    system("ar rcsD gnu.a alpha.o a_rather_long_member_name.o");
+    report("create_archive", same_file("mine.a", "gnu.a"));
+
+    // Same size, same symbols: the member is patched in place and the result still matches ar
+    alpha = "int alpha(void) { return 7; }\nint shared_counter;\n";
+    write_whole_file("alpha.c", alpha, strlen(alpha));
+    system("cc -c alpha.c");
+    struct stat before, after;
+    stat("mine.a", &before);
+    create_archive("mine.a", objects, 1);
+    stat("mine.a", &after);
+    system("ar rcsD gnu.a alpha.o");
+    report("archive in place", before.st_ino == after.st_ino && same_file("mine.a", "gnu.a"));
+
+    // A new symbol moves the index, so the archive is rewritten
+    alpha = "int alpha(void) { return 3; }\nint gamma_value = 4;\n";
+    write_whole_file("alpha.c", alpha, strlen(alpha));
+    system("cc -c alpha.c");
+    create_archive("mine.a", objects, 1);
+    system("ar rcsD gnu.a alpha.o");
+    report("archive rewrite", same_file("mine.a", "gnu.a"));
+
+    // A member cut off inside its ELF header adds no symbols
+    system("head -c 56 alpha.o > truncated.o");
+    create_archive("mine.a", objects + 2, 1);
+    system("ar rcsD gnu.a truncated.o 2>/dev/null");
+    report("archive truncated elf", same_file("mine.a", "gnu.a"));
+
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    system(command);
+}
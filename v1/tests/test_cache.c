@@ -0,0 +1,39 @@
+#define S_CURLE
+#include "../samba.h"
+
+// Run through tests/test_cache.sh, which starts tests/cache_server.py and passes its URL
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <cache url>\n", argv[0]);
+        return 1;
+    }
+    char dir[] = "/tmp/samba-cache-test-XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) return 1;
+    write_whole_file("hello.c", "int hello(void) { return 42; }\n", 31);
+
+    printf("My lovely Cache Tests: 😍😘\n");
+    set_build_directory(dir);
+    add_flag("-c");
+    set_remote_cache(argv[1]);
+    set_cache_directory("first");
+    compile("hello.c", "hello.o", false);
+    flush_remote_cache();
+
+    // A second machine: empty local cache, same source and flags
+    size_t len, object_len, fetched_len;
+    char key[33];
+    char *source = preprocess_source("hello.c", "probe", &len);
+    object_cache_key("hello.c", source, len, key);
+    set_cache_directory("second");
+    bool hit = object_cache_fetch(key, "fetched.o");
+    char *object = read_whole_file("hello.o", &object_len);
+    char *fetched = read_whole_file("fetched.o", &fetched_len);
+    bool same = hit && object && fetched && object_len == fetched_len && memcmp(object, fetched, object_len) == 0;
+    if (same) printf("| remote object cache   | working ✔\n");
+    else printf("| remote object cache   | not working ✖\n");
+
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    system(command);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,9 @@
+#!/bin/sh
+# Builds and runs test_cache.c against the stand-in cache server
+cd "$(dirname "$0")" || exit 1
+port=${SAMBA_TEST_PORT:-18731}
+python3 cache_server.py "$port" &
+server=$!
+trap 'kill $server' EXIT
+sleep 1
+gcc test_cache.c -o /tmp/samba_test_cache -lcurl -lpthread && /tmp/samba_test_cache "http://127.0.0.1:$port"
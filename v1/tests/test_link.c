@@ -0,0 +1,116 @@
+#define S_PARTIAL_LINK_GROUP 4
+#include "../samba.h"
+#include <dirent.h>
+
+// Runs link_objects over 41 small objects; needs cc on the PATH
+#define NUM_OBJECTS 41
+
+typedef struct {
+    char name[32];
+    ino_t inode;
+    long long mtime;
+} partial_t;
+
+static partial_t partials[NUM_OBJECTS];
+static size_t num_partials = 0;
+
+static void report(const char *name, bool working) {
+    if (working) printf("| %-21s | working ✔\n", name);
+    else printf("| %-21s | not working ✖\n", name);
+}
+
+// Cached partial links are named after their 16 digit group key
+static void scan_partials() {
+    num_partials = 0;
+    DIR *dir = opendir("build/.partial");
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) && num_partials < NUM_OBJECTS) {
+        if (strlen(entry->d_name) != 18 || strcmp(entry->d_name + 16, ".o") != 0) continue;
+        char path[PATH_MAX];
+        struct stat info;
+        snprintf(path, sizeof(path), "build/.partial/%s", entry->d_name);
+        if (stat(path, &info) != 0) continue;
+        partial_t *partial = &partials[num_partials++];
+        snprintf(partial->name, sizeof(partial->name), "%s", entry->d_name);
+        partial->inode = info.st_ino;
+        partial->mtime = file_mtime_ns(&info);
+    }
+    closedir(dir);
+}
+
+// How many of the partial links in before are still there, untouched
+static size_t kept_partials(partial_t *before, size_t count) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < num_partials; j++) {
+            if (strcmp(before[i].name, partials[j].name) == 0 && before[i].inode == partials[j].inode &&
+                before[i].mtime == partials[j].mtime) {
+                kept++;
+            }
+        }
+    }
+    return kept;
+}
+
+int main() {
+    char dir[] = "/tmp/samba-link-test-XXXXXX";
+    if (!mkdtemp(dir) || chdir(dir) != 0) return 1;
+    printf("My lovely Link Tests: 😍😘\n");
+
+    char *objects[NUM_OBJECTS + 1];
+    char source[128];
+    const char *main_source = "int f1(void); int f40(void);\nint main(void) { return f1() + f40(); }\n";
+    write_whole_file("main.c", main_source, strlen(main_source));
+    if (system("cc -c main.c") != 0) return 1;
+    objects[0] = strdup("main.o");
+    for (int i = 1; i < NUM_OBJECTS; i++) {
+        char path[32];
+        snprintf(source, sizeof(source), "int f%d(void) { return %d; }\n", i, i);
+        snprintf(path, sizeof(path), "f%d.c", i);
+        write_whole_file(path, source, strlen(source));
+        snprintf(source, sizeof(source), "cc -c %s", path);
+        if (system(source) != 0) return 1;
+        snprintf(path, sizeof(path), "f%d.o", i);
+        objects[i] = strdup(path);
+    }
+
+    set_build_directory("build");
+    link_objects(objects, NUM_OBJECTS, "app", false);
+    scan_partials();
+    bool first_run_plain = num_partials == 0;
+
+    // Groups seen twice are merged, and a third run reuses those merges as they are
+    link_objects(objects, NUM_OBJECTS, "app", false);
+    scan_partials();
+    partial_t merged[NUM_OBJECTS];
+    size_t num_merged = num_partials;
+    memcpy(merged, partials, sizeof(partial_t) * num_partials);
+    size_t len = 0;
+    char *response = read_whole_file("build/.partial/link.rsp", &len);
+    bool uses_partials = response && strstr(response, ".partial/") != NULL;
+    free(response);
+    link_objects(objects, NUM_OBJECTS, "app", false);
+    scan_partials();
+    report("partial link reuse", first_run_plain && num_merged > 0 && uses_partials &&
+                                 num_partials == num_merged && kept_partials(merged, num_merged) == num_merged);
+
+    // Dropping an object that does not end its group only invalidates that group
+    int drop = 0;
+    for (int i = 2; i < NUM_OBJECTS - 1 && !drop; i++) {
+        if (hash_bytes(objects[i], strlen(objects[i]), 0) % S_PARTIAL_LINK_GROUP != 0) drop = i;
+    }
+    char *dropped = objects[drop];
+    memmove(&objects[drop], &objects[drop + 1], sizeof(char *) * (NUM_OBJECTS - drop - 1));
+    link_objects(objects, NUM_OBJECTS - 1, "app", false);
+    scan_partials();
+    report("partial link removal", drop && num_partials == num_merged - 1 &&
+                                   kept_partials(merged, num_merged) == num_merged - 1);
+
+    report("partial link binary", WEXITSTATUS(system("./build/app")) == 41);
+
+    free(dropped);
+    for (int i = 0; i < NUM_OBJECTS - 1; i++) free(objects[i]);
+    snprintf(source, sizeof(source), "rm -rf %s", dir);
+    system(source);
+}
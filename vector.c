@@ -1,8 +1,87 @@
 #include "vector.h"
 
+static double vector_growth_factor = 2.0;
+
+static ssize_t vector_find_fixed(const void *data, size_t size, size_t element_size, const void *value);
+
+void vector_fail(const char *message) {
+    fprintf(stderr, "%s\n", message);
+    exit(EXIT_FAILURE);
+}
+
+void vector_set_growth_factor(double factor) {
+    vector_growth_factor = factor > 1.0 ? factor : 2.0;
+}
+
+size_t vector_grow_capacity(size_t capacity, size_t needed) {
+    size_t grown = (size_t)((double)capacity * vector_growth_factor);
+    if (grown <= capacity) grown = capacity + 1;
+    return grown > needed ? grown : needed;
+}
+
+static void *vector_allocate(const VectorAllocator *allocator, size_t size) {
+    return allocator ? allocator->alloc(allocator->context, size) : malloc(size);
+}
+
+static void vector_release(const VectorAllocator *allocator, void *pointer, size_t size) {
+    if (allocator) allocator->free(allocator->context, pointer, size);
+    else free(pointer);
+}
+
+// Only a custom allocator needs the size, and only then may the element be assumed NUL-terminated
+static void vector_release_string(const VectorAllocator *allocator, char *str) {
+    if (!str) return;
+    if (allocator) allocator->free(allocator->context, str, strlen(str) + 1);
+    else free(str);
+}
+
+static void vector_destroy_string(Vector *vector, void *element) {
+    vector_release_string(vector->allocator, *(char **)element);
+}
+
+static void vector_copy_string(Vector *dest, void *element, const void *source) {
+    const char *str = *(char *const *)source;
+    char *copy = NULL;
+    if (str) {
+        size_t len = strlen(str) + 1;
+        copy = vector_allocate(dest->allocator, len);
+        if (!copy) vector_fail("Failed to allocate memory");
+        memcpy(copy, str, len);
+    }
+    *(char **)element = copy;
+}
+
+int vector_compare_string(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void vector_destroy_vector(Vector *vector, void *element) {
+    (void)vector;
+    vector_free((Vector *)element);
+}
+
+static void vector_copy_vector(Vector *dest, void *element, const void *source) {
+    (void)dest;
+    vector_copy((Vector *)element, (const Vector *)source);
+}
+
+const VectorOps vector_ops_string = { vector_destroy_string, vector_copy_string, vector_compare_string };
+const VectorOps vector_ops_string_borrowed = { NULL, NULL, vector_compare_string };
+const VectorOps vector_ops_vector = { vector_destroy_vector, vector_copy_vector, NULL };
+const VectorOps vector_ops_plain = { NULL, NULL, NULL };
+
 void vector_init(Vector *vector, size_t initial_capacity, size_t element_size) {
+    vector_init_with(vector, initial_capacity, element_size, NULL);
+}
+
+void vector_init_ops(Vector *vector, size_t initial_capacity, size_t element_size, const VectorOps *ops) {
+    vector_init_with(vector, initial_capacity, element_size, NULL);
+    vector->ops = ops;
+}
+
+void vector_init_with(Vector *vector, size_t initial_capacity, size_t element_size, const VectorAllocator *allocator) {
     if (initial_capacity == 0) initial_capacity = 1;
-    vector->data = malloc(initial_capacity * element_size);
+    vector->data = vector_allocate(allocator, initial_capacity * element_size);
     if (!vector->data) {
         fprintf(stderr, "Failed to allocate memory\n");
         exit(EXIT_FAILURE);
@@ -10,11 +89,16 @@ void vector_init(Vector *vector, size_t initial_capacity, size_t element_size) {
     vector->size = 0;
     vector->capacity = initial_capacity;
     vector->element_size = element_size;
+    vector->allocator = allocator;
+    vector->ops = NULL;
 }
 
 void vector_resize(Vector *vector, size_t new_capacity) {
     if (new_capacity == 0) new_capacity = 1;
-    void *new_data = realloc(vector->data, new_capacity * vector->element_size);
+    const VectorAllocator *allocator = vector->allocator;
+    void *new_data = allocator
+        ? allocator->realloc(allocator->context, vector->data, vector->capacity * vector->element_size, new_capacity * vector->element_size)
+        : realloc(vector->data, new_capacity * vector->element_size);
     if (!new_data) {
         fprintf(stderr, "Failed to reallocate memory\n");
         exit(EXIT_FAILURE);
@@ -23,15 +107,35 @@ void vector_resize(Vector *vector, size_t new_capacity) {
     vector->capacity = new_capacity;
 }
 
+void vector_reserve(Vector *vector, size_t capacity) {
+    if (capacity > vector->capacity) vector_resize(vector, capacity);
+}
+
 void vector_push(Vector *vector, const void *value) {
     if (vector->size == vector->capacity) {
-        vector_resize(vector, vector->capacity == 0 ? 1 : vector->capacity * 2);
+        vector_resize(vector, vector_grow_capacity(vector->capacity, vector->size + 1));
     }
     void *target = (char *)vector->data + (vector->size * vector->element_size);
     memcpy(target, value, vector->element_size);
     vector->size++;
 }
 
+void vector_extend(Vector *vector, const void *values, size_t count) {
+    vector_insert_range(vector, vector->size, values, count);
+}
+
+void vector_insert_range(Vector *vector, size_t index, const void *values, size_t count) {
+    if (index > vector->size) vector_fail("Index out of bounds");
+    if (count == 0) return;
+    if (vector->size + count > vector->capacity) {
+        vector_resize(vector, vector_grow_capacity(vector->capacity, vector->size + count));
+    }
+    char *target = (char *)vector->data + index * vector->element_size;
+    memmove(target + count * vector->element_size, target, (vector->size - index) * vector->element_size);
+    memcpy(target, values, count * vector->element_size);
+    vector->size += count;
+}
+
 void *vector_get(Vector *vector, size_t index) {
     if (index >= vector->size) {
         fprintf(stderr, "Index out of bounds\n");
@@ -50,6 +154,11 @@ void vector_set(Vector *vector, size_t index, const void *value) {
 }
 
 bool vector_contains(Vector *vector, const void *value) {
+    // String vectors keep the old contract and take the string itself, whether or not they carry ops
+    if (vector->ops && vector->ops->compare != vector_compare_string) return vector_find(vector, value) >= 0;
+    // Pointer-sized elements are compared as strings below (also where pointers are 4 bytes),
+    // so only other 4-byte vectors can take the SIMD scan
+    if (vector->element_size == 4 && vector->element_size != sizeof(char *)) return vector_find_fixed(vector->data, vector->size, 4, value) >= 0;
     for (size_t i = 0; i < vector->size; i++) {
         void *current_element = (char *)vector->data + (i * vector->element_size);
 
@@ -80,6 +189,15 @@ void vector_remove(Vector *vector, size_t index) {
 }
 
 ssize_t vector_find(Vector *vector, const void *value) {
+    if (vector->ops && vector->ops->compare) {
+        for (size_t i = 0; i < vector->size; i++) {
+            if (vector->ops->compare((char *)vector->data + i * vector->element_size, value) == 0) return i;
+        }
+        return -1;
+    }
+    if (vector->element_size == 4 || vector->element_size == 8) {
+        return vector_find_fixed(vector->data, vector->size, vector->element_size, value);
+    }
     for (size_t i = 0; i < vector->size; i++) {
         void *current_element = (char *)vector->data + (i * vector->element_size);
         if (memcmp(current_element, value, vector->element_size) == 0) {
@@ -90,22 +208,39 @@ ssize_t vector_find(Vector *vector, const void *value) {
 }
 
 void vector_compress(Vector *vector) {
+    vector_shrink_to_fit(vector);
+}
+
+void vector_shrink_to_fit(Vector *vector) {
     if (vector->capacity > vector->size) {
         vector_resize(vector, vector->size);
     }
 }
 
 void vector_copy(Vector *dest, const Vector *src) {
-    vector_init(dest, src->capacity, src->element_size);
-    memcpy(dest->data, src->data, src->size * src->element_size);
+    vector_init_with(dest, src->size, src->element_size, src->allocator);
+    dest->ops = src->ops;
+    if (src->ops && src->ops->copy) {
+        for (size_t i = 0; i < src->size; i++) {
+            size_t offset = i * src->element_size;
+            src->ops->copy(dest, (char *)dest->data + offset, (const char *)src->data + offset);
+        }
+    } else {
+        memcpy(dest->data, src->data, src->size * src->element_size);
+    }
     dest->size = src->size;
 }
 
 void vector_free(Vector *vector) {
-    if (vector->element_size == sizeof(char *)) {
+    if (vector->ops) {
+        if (vector->ops->destroy) {
+            for (size_t i = 0; i < vector->size; i++) {
+                vector->ops->destroy(vector, (char *)vector->data + i * vector->element_size);
+            }
+        }
+    } else if (vector->element_size == sizeof(char *)) {
         for (size_t i = 0; i < vector->size; i++) {
-            char **element = (char **)vector_get(vector, i);
-            free(*element);
+            vector_release_string(vector->allocator, *(char **)vector_get(vector, i));
         }
     } else if (vector->element_size == sizeof(Vector)) {
         for (size_t i = 0; i < vector->size; i++) {
@@ -114,11 +249,12 @@ void vector_free(Vector *vector) {
         }
     }
 
-    free(vector->data);
+    if (vector->data) vector_release(vector->allocator, vector->data, vector->capacity * vector->element_size);
     vector->data = NULL;
     vector->size = 0;
     vector->capacity = 0;
     vector->element_size = 0;
+    vector->ops = NULL;
 }
 
 size_t vector_len(Vector *vector) {
@@ -137,42 +273,1302 @@ void *vector_pop(Vector *vector) {
     return last_element;
 }
 
+// ------ Search ------
+// vector_find over 4- and 8-byte elements compares whole registers at a time: AVX2 when the CPU
+// has it (checked at runtime, so the library still builds for baseline x86-64), SSE2 otherwise
+// and a plain loop on other architectures. Each pass covers 32 (AVX2) or 16 (SSE2) 4-byte
+// elements, half that for 8-byte ones.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define VECTOR_SIMD_X86 1
+#endif
+
+static ssize_t vector_find_scalar(const void *data, size_t size, size_t element_size, const void *value, size_t from) {
+    if (element_size == 4) {
+        const uint32_t *items = (const uint32_t *)data;
+        uint32_t needle;
+        memcpy(&needle, value, 4);
+        for (size_t i = from; i < size; i++) {
+            if (items[i] == needle) return (ssize_t)i;
+        }
+    } else {
+        const uint64_t *items = (const uint64_t *)data;
+        uint64_t needle;
+        memcpy(&needle, value, 8);
+        for (size_t i = from; i < size; i++) {
+            if (items[i] == needle) return (ssize_t)i;
+        }
+    }
+    return -1;
+}
+
+#ifdef VECTOR_SIMD_X86
+static inline uint32_t vector_ctz(uint32_t x) {
+    return (uint32_t)__builtin_ctz(x);
+}
+
+static ssize_t vector_find_sse2(const void *data, size_t size, size_t element_size, const void *value) {
+    const char *base = (const char *)data;
+    size_t per_register = 16 / element_size;
+    size_t step = per_register * 4;
+    size_t i = 0;
+    __m128i needle;
+    if (element_size == 4) {
+        uint32_t v;
+        memcpy(&v, value, 4);
+        needle = _mm_set1_epi32((int)v);
+    } else {
+        uint64_t v;
+        memcpy(&v, value, 8);
+        needle = _mm_set1_epi64x((long long)v);
+    }
+    for (; i + step <= size; i += step) {
+        const __m128i *p = (const __m128i *)(base + i * element_size);
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128(p), needle);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128(p + 1), needle);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128(p + 2), needle);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128(p + 3), needle);
+        if (element_size == 8) {
+            // SSE2 has no 64-bit compare: a lane matches only if both of its halves do
+            a = _mm_and_si128(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+            b = _mm_and_si128(b, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 0, 1)));
+            c = _mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 3, 0, 1)));
+            d = _mm_and_si128(d, _mm_shuffle_epi32(d, _MM_SHUFFLE(2, 3, 0, 1)));
+        }
+        __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (!_mm_movemask_epi8(any)) continue;
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(a) | (uint32_t)_mm_movemask_epi8(b) << 16;
+        if (mask) return (ssize_t)(i + vector_ctz(mask) / element_size);
+        mask = (uint32_t)_mm_movemask_epi8(c) | (uint32_t)_mm_movemask_epi8(d) << 16;
+        return (ssize_t)(i + per_register * 2 + vector_ctz(mask) / element_size);
+    }
+    return vector_find_scalar(data, size, element_size, value, i);
+}
+
+__attribute__((target("avx2")))
+static ssize_t vector_find_avx2(const void *data, size_t size, size_t element_size, const void *value) {
+    const char *base = (const char *)data;
+    size_t per_register = 32 / element_size;
+    size_t step = per_register * 4;
+    size_t i = 0;
+    __m256i needle;
+    if (element_size == 4) {
+        uint32_t v;
+        memcpy(&v, value, 4);
+        needle = _mm256_set1_epi32((int)v);
+    } else {
+        uint64_t v;
+        memcpy(&v, value, 8);
+        needle = _mm256_set1_epi64x((long long)v);
+    }
+    for (; i + step <= size; i += step) {
+        const __m256i *p = (const __m256i *)(base + i * element_size);
+        __m256i a, b, c, d;
+        if (element_size == 4) {
+            a = _mm256_cmpeq_epi32(_mm256_loadu_si256(p), needle);
+            b = _mm256_cmpeq_epi32(_mm256_loadu_si256(p + 1), needle);
+            c = _mm256_cmpeq_epi32(_mm256_loadu_si256(p + 2), needle);
+            d = _mm256_cmpeq_epi32(_mm256_loadu_si256(p + 3), needle);
+        } else {
+            a = _mm256_cmpeq_epi64(_mm256_loadu_si256(p), needle);
+            b = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 1), needle);
+            c = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 2), needle);
+            d = _mm256_cmpeq_epi64(_mm256_loadu_si256(p + 3), needle);
+        }
+        __m256i any = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+        if (_mm256_testz_si256(any, any)) continue;
+        __m256i quarters[4] = { a, b, c, d };
+        for (int q = 0; q < 4; q++) {
+            uint32_t mask = (uint32_t)_mm256_movemask_epi8(quarters[q]);
+            if (mask) return (ssize_t)(i + per_register * (size_t)q + vector_ctz(mask) / element_size);
+        }
+    }
+    return vector_find_scalar(data, size, element_size, value, i);
+}
+#endif
+
+static ssize_t vector_find_fixed(const void *data, size_t size, size_t element_size, const void *value) {
+#ifdef VECTOR_SIMD_X86
+    if (size >= 16) {
+        if (__builtin_cpu_supports("avx2")) return vector_find_avx2(data, size, element_size, value);
+        return vector_find_sse2(data, size, element_size, value);
+    }
+#endif
+    return vector_find_scalar(data, size, element_size, value, 0);
+}
+
+void vector_find_many(Vector *vector, const void *values, size_t count, ssize_t *indexes) {
+    const char *needles = (const char *)values;
+    size_t element_size = vector->element_size;
+    // A handful of needles is fastest as independent SIMD scans that stop at their first hit
+    if (count <= 8 || (element_size != 4 && element_size != 8) || (vector->ops && vector->ops->compare)) {
+        for (size_t j = 0; j < count; j++) {
+            indexes[j] = vector_find(vector, needles + j * element_size);
+        }
+        return;
+    }
+
+    // Otherwise hash the needles and walk the vector once, stopping when every one is resolved
+    HashMap pending;
+    hashmap_init(&pending, HASHMAP_INT);
+    hashmap_reserve(&pending, count);
+    size_t unresolved = 0;
+    for (size_t j = 0; j < count; j++) {
+        uint64_t key = 0;
+        memcpy(&key, needles + j * element_size, element_size);
+        void **slot = hashmap_put_int(&pending, key);
+        indexes[j] = -1;
+        if (*slot == NULL) {
+            *slot = (void *)(uintptr_t)(j + 1);
+            unresolved++;
+        }
+    }
+    const char *items = (const char *)vector->data;
+    for (size_t i = 0; i < vector->size && unresolved; i++) {
+        uint64_t key = 0;
+        memcpy(&key, items + i * element_size, element_size);
+        size_t first = (size_t)(uintptr_t)hashmap_get_int(&pending, key);
+        if (first && indexes[first - 1] < 0) {
+            indexes[first - 1] = (ssize_t)i;
+            unresolved--;
+        }
+    }
+    // Repeated needles share the answer of their first occurrence
+    for (size_t j = 0; j < count; j++) {
+        uint64_t key = 0;
+        memcpy(&key, needles + j * element_size, element_size);
+        size_t first = (size_t)(uintptr_t)hashmap_get_int(&pending, key);
+        indexes[j] = indexes[first - 1];
+    }
+    hashmap_free(&pending);
+}
+
+// ------ Sorting ------
+// vector_sort is an introsort (quicksort, heapsort once recursion gets too deep, insertion sort
+// for short ranges). The two comparators this file exports are recognised and routed to
+// specialised code: strings sort on typed char * arrays with strcmp inlined and 4- or 8-byte
+// integers go through an LSD radix sort that skips the byte passes that are all the same.
+
+#define VECTOR_SORT_SMALL 16
+
+static size_t vector_log2(size_t n) {
+    size_t depth = 0;
+    while (n >>= 1) depth++;
+    return depth;
+}
+
+// Typed introsort: NAME##_sort(T *items, size_t count) ordering by LESS(a, b)
+#define VECTOR_INTROSORT(NAME, T, LESS) \
+    static void NAME##_insertion(T *items, size_t count) { \
+        for (size_t i = 1; i < count; i++) { \
+            T item = items[i]; \
+            size_t j = i; \
+            while (j > 0 && LESS(item, items[j - 1])) { \
+                items[j] = items[j - 1]; \
+                j--; \
+            } \
+            items[j] = item; \
+        } \
+    } \
+    static void NAME##_sift(T *items, size_t root, size_t count) { \
+        T item = items[root]; \
+        for (size_t child; (child = 2 * root + 1) < count; root = child) { \
+            if (child + 1 < count && LESS(items[child], items[child + 1])) child++; \
+            if (!LESS(item, items[child])) break; \
+            items[root] = items[child]; \
+        } \
+        items[root] = item; \
+    } \
+    static void NAME##_heapsort(T *items, size_t count) { \
+        for (size_t i = count / 2; i-- > 0;) NAME##_sift(items, i, count); \
+        for (size_t end = count - 1; end > 0; end--) { \
+            T top = items[0]; \
+            items[0] = items[end]; \
+            items[end] = top; \
+            NAME##_sift(items, 0, end); \
+        } \
+    } \
+    static void NAME##_introsort(T *items, size_t count, size_t depth) { \
+        while (count > VECTOR_SORT_SMALL) { \
+            if (depth-- == 0) { \
+                NAME##_heapsort(items, count); \
+                return; \
+            } \
+            /* Median of three moved to the front, then Hoare partition around it */ \
+            size_t mid = count / 2; \
+            T tmp; \
+            if (LESS(items[mid], items[0])) { tmp = items[mid]; items[mid] = items[0]; items[0] = tmp; } \
+            if (LESS(items[count - 1], items[mid])) { tmp = items[count - 1]; items[count - 1] = items[mid]; items[mid] = tmp; } \
+            if (LESS(items[mid], items[0])) { tmp = items[mid]; items[mid] = items[0]; items[0] = tmp; } \
+            tmp = items[mid]; items[mid] = items[0]; items[0] = tmp; \
+            T pivot = items[0]; \
+            size_t i = 0, j = count; \
+            for (;;) { \
+                do i++; while (i < count && LESS(items[i], pivot)); \
+                do j--; while (LESS(pivot, items[j])); \
+                if (i >= j) break; \
+                tmp = items[i]; items[i] = items[j]; items[j] = tmp; \
+            } \
+            items[0] = items[j]; \
+            items[j] = pivot; \
+            /* Recurse into the smaller side, loop on the larger */ \
+            if (j < count - j - 1) { \
+                NAME##_introsort(items, j, depth); \
+                items += j + 1; \
+                count -= j + 1; \
+            } else { \
+                NAME##_introsort(items + j + 1, count - j - 1, depth); \
+                count = j; \
+            } \
+        } \
+        NAME##_insertion(items, count); \
+    } \
+    static void NAME##_sort(T *items, size_t count) { \
+        if (count > 1) NAME##_introsort(items, count, 2 * vector_log2(count)); \
+    }
+
+#define VECTOR_LESS_STRING(a, b) (strcmp((a), (b)) < 0)
+#define VECTOR_LESS_VALUE(a, b) ((a) < (b))
+
+VECTOR_INTROSORT(vector_sort_str, char *, VECTOR_LESS_STRING)
+VECTOR_INTROSORT(vector_sort_i32, int32_t, VECTOR_LESS_VALUE)
+VECTOR_INTROSORT(vector_sort_u32, uint32_t, VECTOR_LESS_VALUE)
+VECTOR_INTROSORT(vector_sort_i64, int64_t, VECTOR_LESS_VALUE)
+VECTOR_INTROSORT(vector_sort_u64, uint64_t, VECTOR_LESS_VALUE)
+
+int vector_compare_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Generic introsort on raw elements through the comparator
+static void vector_swap(char *a, char *b, size_t size) {
+    char tmp[64];
+    while (size) {
+        size_t chunk = size < sizeof(tmp) ? size : sizeof(tmp);
+        memcpy(tmp, a, chunk);
+        memcpy(a, b, chunk);
+        memcpy(b, tmp, chunk);
+        a += chunk;
+        b += chunk;
+        size -= chunk;
+    }
+}
+
+static void vector_sift_generic(char *base, size_t root, size_t count, size_t size, int (*compare)(const void *, const void *)) {
+    for (size_t child; (child = 2 * root + 1) < count; root = child) {
+        if (child + 1 < count && compare(base + child * size, base + (child + 1) * size) < 0) child++;
+        if (compare(base + root * size, base + child * size) >= 0) return;
+        vector_swap(base + root * size, base + child * size, size);
+    }
+}
+
+static void vector_introsort_generic(char *base, size_t count, size_t size, size_t depth, int (*compare)(const void *, const void *)) {
+    while (count > VECTOR_SORT_SMALL) {
+        if (depth-- == 0) {
+            for (size_t i = count / 2; i-- > 0;) vector_sift_generic(base, i, count, size, compare);
+            for (size_t end = count - 1; end > 0; end--) {
+                vector_swap(base, base + end * size, size);
+                vector_sift_generic(base, 0, end, size, compare);
+            }
+            return;
+        }
+        char *first = base, *mid = base + (count / 2) * size, *last = base + (count - 1) * size;
+        if (compare(mid, first) < 0) vector_swap(mid, first, size);
+        if (compare(last, mid) < 0) vector_swap(last, mid, size);
+        if (compare(mid, first) < 0) vector_swap(mid, first, size);
+        vector_swap(first, mid, size);
+        size_t i = 0, j = count;
+        for (;;) {
+            do i++; while (i < count && compare(base + i * size, base) < 0);
+            do j--; while (compare(base, base + j * size) < 0);
+            if (i >= j) break;
+            vector_swap(base + i * size, base + j * size, size);
+        }
+        vector_swap(base, base + j * size, size);
+        if (j < count - j - 1) {
+            vector_introsort_generic(base, j, size, depth, compare);
+            base += (j + 1) * size;
+            count -= j + 1;
+        } else {
+            vector_introsort_generic(base + (j + 1) * size, count - j - 1, size, depth, compare);
+            count = j;
+        }
+    }
+    for (size_t i = 1; i < count; i++) {
+        for (size_t j = i; j > 0 && compare(base + j * size, base + (j - 1) * size) < 0; j--) {
+            vector_swap(base + j * size, base + (j - 1) * size, size);
+        }
+    }
+}
+
+// LSD radix sort of unsigned keys, one byte per pass. Signed keys are handled by flipping the
+// sign bit, which maps them onto the same unsigned order.
+#define VECTOR_RADIX_SORT(NAME, T) \
+    static void NAME(T *items, size_t count, bool is_signed) { \
+        const T flip = is_signed ? (T)1 << (sizeof(T) * 8 - 1) : 0; \
+        T *tmp = malloc(count * sizeof(T)); \
+        if (!tmp) vector_fail("Failed to allocate memory"); \
+        size_t histogram[sizeof(T)][256]; \
+        memset(histogram, 0, sizeof(histogram)); \
+        for (size_t i = 0; i < count; i++) { \
+            T key = items[i] ^ flip; \
+            for (size_t b = 0; b < sizeof(T); b++) histogram[b][(key >> (b * 8)) & 0xff]++; \
+        } \
+        T *in = items, *out = tmp; \
+        for (size_t b = 0; b < sizeof(T); b++) { \
+            size_t *counts = histogram[b]; \
+            if (counts[((items[0] ^ flip) >> (b * 8)) & 0xff] == count) continue; /* byte is the same everywhere */ \
+            size_t offset = 0; \
+            for (int v = 0; v < 256; v++) { \
+                size_t n = counts[v]; \
+                counts[v] = offset; \
+                offset += n; \
+            } \
+            for (size_t i = 0; i < count; i++) { \
+                T key = in[i]; \
+                out[counts[((key ^ flip) >> (b * 8)) & 0xff]++] = key; \
+            } \
+            T *swap = in; \
+            in = out; \
+            out = swap; \
+        } \
+        if (in != items) memcpy(items, in, count * sizeof(T)); \
+        free(tmp); \
+    }
+
+VECTOR_RADIX_SORT(vector_radix_sort32, uint32_t)
+VECTOR_RADIX_SORT(vector_radix_sort64, uint64_t)
+
+void vector_sort_ints(Vector *vector, bool is_signed) {
+    size_t size = vector->element_size;
+    if (size != 4 && size != 8) vector_fail("vector_sort_ints needs 4- or 8-byte elements");
+    if (vector->size < 256) {
+        // Below this the histogram setup costs more than it saves
+        if (size == 4 && is_signed) vector_sort_i32_sort(vector->data, vector->size);
+        else if (size == 4) vector_sort_u32_sort(vector->data, vector->size);
+        else if (is_signed) vector_sort_i64_sort(vector->data, vector->size);
+        else vector_sort_u64_sort(vector->data, vector->size);
+        return;
+    }
+    if (size == 4) vector_radix_sort32(vector->data, vector->size, is_signed);
+    else vector_radix_sort64(vector->data, vector->size, is_signed);
+}
+
+void vector_sort_strings(Vector *vector) {
+    if (vector->element_size != sizeof(char *)) vector_fail("vector_sort_strings needs char * elements");
+    vector_sort_str_sort(vector->data, vector->size);
+}
+
+static int (*vector_comparator(Vector *vector, int (*compare)(const void *, const void *)))(const void *, const void *) {
+    if (!compare && vector->ops) compare = vector->ops->compare;
+    if (!compare) vector_fail("Vector has no comparator");
+    return compare;
+}
+
+void vector_sort(Vector *vector, int (*compare)(const void *, const void *)) {
+    compare = vector_comparator(vector, compare);
+    if (compare == vector_compare_string && vector->element_size == sizeof(char *)) {
+        vector_sort_strings(vector);
+    } else if (compare == vector_compare_int && vector->element_size == sizeof(int)) {
+        vector_sort_ints(vector, true);
+    } else if (vector->size > 1) {
+        vector_introsort_generic(vector->data, vector->size, vector->element_size, 2 * vector_log2(vector->size), compare);
+    }
+}
+
+size_t vector_lower_bound(Vector *vector, const void *key, int (*compare)(const void *, const void *)) {
+    compare = vector_comparator(vector, compare);
+    const char *base = vector->data;
+    size_t size = vector->element_size;
+    size_t first = 0, count = vector->size;
+    while (count > 0) {
+        size_t half = count / 2;
+        if (compare(base + (first + half) * size, key) < 0) {
+            first += half + 1;
+            count -= half + 1;
+        } else {
+            count = half;
+        }
+    }
+    return first;
+}
+
+ssize_t vector_bsearch(Vector *vector, const void *key, int (*compare)(const void *, const void *)) {
+    compare = vector_comparator(vector, compare);
+    size_t index = vector_lower_bound(vector, key, compare);
+    if (index < vector->size && compare((char *)vector->data + index * vector->element_size, key) == 0) {
+        return (ssize_t)index;
+    }
+    return -1;
+}
+
+// ------ Tokenizer ------
+// vector_tokenize records (pointer, length) slices of the input instead of copying it. The hot
+// loop hunts for the next byte that can end or complicate a token (a delimiter, a quote, a
+// backslash, ...), comparing 32 (AVX2) or 16 (SSE2) bytes at a time against every byte of that set.
+
+typedef struct {
+    bool delimiter[256];
+    bool special[256];
+    unsigned char chars[16];  // the special bytes, for the SIMD scan; unused when there are more
+    int count;
+    bool avx2;
+} TokenSet;
+
+static void token_set_add(TokenSet *set, unsigned char c) {
+    if (set->special[c]) return;
+    set->special[c] = true;
+    if (set->count < (int)sizeof(set->chars)) set->chars[set->count] = c;
+    set->count++;
+}
+
+static void token_set_init(TokenSet *set, const char *delimiters, TokenizeMode mode) {
+    memset(set, 0, sizeof(*set));
+    for (const unsigned char *d = (const unsigned char *)delimiters; *d; d++) {
+        set->delimiter[*d] = true;
+        token_set_add(set, *d);
+    }
+    if (mode == TOKENIZE_SHELL) {
+        token_set_add(set, '\\');
+        token_set_add(set, '\'');
+        token_set_add(set, '"');
+    } else if (mode == TOKENIZE_DEPFILE) {
+        token_set_add(set, '\\');
+        token_set_add(set, '$');
+        token_set_add(set, ':');
+    }
+#ifdef VECTOR_SIMD_X86
+    set->avx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+#ifdef VECTOR_SIMD_X86
+static const char *token_scan_sse2(const TokenSet *set, const char *p, const char *end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits = _mm_setzero_si128();
+        for (int i = 0; i < set->count; i++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)set->chars[i])));
+        }
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hits);
+        if (mask) return p + vector_ctz(mask);
+    }
+    return p;
+}
+
+__attribute__((target("avx2")))
+static const char *token_scan_avx2(const TokenSet *set, const char *p, const char *end) {
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hits = _mm256_setzero_si256();
+        for (int i = 0; i < set->count; i++) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8((char)set->chars[i])));
+        }
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hits);
+        if (mask) return p + vector_ctz(mask);
+    }
+    return p;
+}
+#endif
+
+// First special byte in [p, end), or end
+static const char *token_scan(const TokenSet *set, const char *p, const char *end) {
+#ifdef VECTOR_SIMD_X86
+    if (set->count <= (int)sizeof(set->chars)) {
+        p = set->avx2 ? token_scan_avx2(set, p, end) : token_scan_sse2(set, p, end);
+    }
+#endif
+    while (p < end && !set->special[(unsigned char)*p]) p++;
+    return p;
+}
+
+// Length of a depfile line continuation (backslash, optional CR, newline) at p, or 0
+static size_t token_continuation(const char *p, const char *end) {
+    if (p[0] != '\\' || p + 1 >= end) return 0;
+    if (p[1] == '\n') return 2;
+    if (p[1] == '\r' && p + 2 < end && p[2] == '\n') return 3;
+    return 0;
+}
+
+size_t vector_tokenize(Vector *tokens, const char *src, size_t len, const char *delimiters, TokenizeMode mode) {
+    if (tokens->element_size != sizeof(Token)) vector_fail("vector_tokenize needs a vector of Token");
+    TokenSet set;
+    token_set_init(&set, delimiters, mode);
+    const char *p = src;
+    const char *end = src + len;
+    size_t before = tokens->size;
+    // First token of the current depfile rule; every token up to its colon is a target
+    size_t rule_start = before;
+
+    for (;;) {
+        while (p < end) {
+            size_t skip = mode == TOKENIZE_DEPFILE ? token_continuation(p, end) : 0;
+            if (skip) {
+                p += skip;
+            } else if (set.delimiter[(unsigned char)*p]) {
+                if (*p == '\n') rule_start = tokens->size;
+                p++;
+            } else {
+                break;
+            }
+        }
+        if (p >= end) break;
+
+        Token token = { p, 0, 0 };
+        for (;;) {
+            p = token_scan(&set, p, end);
+            if (p >= end || set.delimiter[(unsigned char)*p]) break;
+            char c = *p;
+            if (mode == TOKENIZE_SHELL) {
+                token.flags |= TOKEN_ESCAPED;
+                if (c == '\\') {
+                    p = p + 2 < end ? p + 2 : end;
+                } else if (c == '\'') {
+                    const char *close = memchr(p + 1, '\'', (size_t)(end - p - 1));
+                    p = close ? close + 1 : end;
+                } else {
+                    for (p++; p < end && *p != '"'; p++) {
+                        if (*p == '\\' && p + 1 < end) p++;
+                    }
+                    if (p < end) p++;
+                }
+            } else if (mode == TOKENIZE_DEPFILE) {
+                if (c == '\\') {
+                    if (token_continuation(p, end)) break;
+                    if (p + 1 < end && (p[1] == ' ' || p[1] == '#')) {
+                        token.flags |= TOKEN_ESCAPED;
+                        p += 2;
+                    } else {
+                        p++;
+                    }
+                } else if (c == '$') {
+                    if (p + 1 < end && p[1] == '$') {
+                        token.flags |= TOKEN_ESCAPED;
+                        p += 2;
+                    } else {
+                        p++;
+                    }
+                } else {
+                    // A colon ends a target only when whitespace or the end follows, so C:\ stays a path
+                    if (p + 1 >= end || set.delimiter[(unsigned char)p[1]] || token_continuation(p + 1, end)) {
+                        token.flags |= TOKEN_TARGET;
+                        break;
+                    }
+                    p++;
+                }
+            } else {
+                p++;
+            }
+        }
+        token.len = (size_t)(p - token.data);
+        if (token.flags & TOKEN_TARGET) p++;
+        if (token.len) vector_push(tokens, &token);
+        if (token.flags & TOKEN_TARGET) {
+            // "a.o b.o: deps" and "target : deps" name targets before the colon too
+            for (size_t i = rule_start; i < tokens->size; i++) ((Token *)tokens->data)[i].flags |= TOKEN_TARGET;
+            rule_start = tokens->size;
+        }
+    }
+    return tokens->size - before;
+}
+
+size_t token_unescape(const Token *token, TokenizeMode mode, char *dest) {
+    const char *p = token->data;
+    const char *end = p + token->len;
+    char *out = dest;
+    if (!(token->flags & TOKEN_ESCAPED)) {
+        memcpy(out, p, token->len);
+        out += token->len;
+    } else if (mode == TOKENIZE_SHELL) {
+        while (p < end) {
+            char c = *p++;
+            if (c == '\\') {
+                if (p < end) *out++ = *p++;
+            } else if (c == '\'') {
+                while (p < end && *p != '\'') *out++ = *p++;
+                if (p < end) p++;
+            } else if (c == '"') {
+                while (p < end && *p != '"') {
+                    if (*p == '\\' && p + 1 < end && strchr("$`\"\\\n", p[1])) p++;
+                    *out++ = *p++;
+                }
+                if (p < end) p++;
+            } else {
+                *out++ = c;
+            }
+        }
+    } else {
+        while (p < end) {
+            if ((p[0] == '\\' && p + 1 < end && (p[1] == ' ' || p[1] == '#')) ||
+                (p[0] == '$' && p + 1 < end && p[1] == '$')) {
+                p++;
+            }
+            *out++ = *p++;
+        }
+    }
+    *out = '\0';
+    return (size_t)(out - dest);
+}
+
+char *token_dup(const Token *token, TokenizeMode mode) {
+    char *copy = malloc(token->len + 1);
+    if (!copy) vector_fail("Failed to allocate memory");
+    token_unescape(token, mode, copy);
+    return copy;
+}
+
+// ------ Arena ------
+
+#define ARENA_ALIGN 16
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    size_t last;  // offset of the most recent allocation, the only one that can grow in place
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static size_t arena_round(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static void *arena_allocator_alloc(void *context, size_t size) {
+    return arena_alloc((Arena *)context, size);
+}
+
+static void *arena_allocator_realloc(void *context, void *pointer, size_t old_size, size_t new_size) {
+    return arena_realloc((Arena *)context, pointer, old_size, new_size);
+}
+
+static void arena_allocator_free(void *context, void *pointer, size_t size) {
+    (void)context;
+    (void)pointer;
+    (void)size;
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size ? arena_round(block_size) : ARENA_DEFAULT_BLOCK;
+    arena->allocator.alloc = arena_allocator_alloc;
+    arena->allocator.realloc = arena_allocator_realloc;
+    arena->allocator.free = arena_allocator_free;
+    arena->allocator.context = arena;
+}
+
+const VectorAllocator *arena_allocator(Arena *arena) {
+    return &arena->allocator;
+}
+
+static ArenaBlock *arena_new_block(size_t size) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block) vector_fail("Failed to allocate memory");
+    block->size = size;
+    block->used = 0;
+    block->last = 0;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    size = arena_round(size ? size : 1);
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        if (size > arena->block_size / 2) {
+            // Oversized requests get a block of their own behind the current one, so the space
+            // left in the current block is not thrown away
+            ArenaBlock *own = arena_new_block(size);
+            own->used = size;
+            if (block) {
+                own->next = block->next;
+                block->next = own;
+            } else {
+                own->next = NULL;
+                arena->head = own;
+            }
+            return own->data;
+        }
+        block = arena_new_block(arena->block_size);
+        block->next = arena->head;
+        arena->head = block;
+    }
+    block->last = block->used;
+    block->used += size;
+    return block->data + block->last;
+}
+
+void *arena_realloc(Arena *arena, void *pointer, size_t old_size, size_t new_size) {
+    if (!pointer) return arena_alloc(arena, new_size);
+    ArenaBlock *block = arena->head;
+    if (block && pointer == block->data + block->last) {
+        size_t needed = arena_round(new_size ? new_size : 1);
+        if (block->size - block->last >= needed) {
+            block->used = block->last + needed;
+            return pointer;
+        }
+    }
+    if (new_size <= old_size) return pointer;
+    void *moved = arena_alloc(arena, new_size);
+    memcpy(moved, pointer, old_size);
+    return moved;
+}
+
+char *arena_strndup(Arena *arena, const char *str, size_t len) {
+    char *copy = arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *str) {
+    return arena_strndup(arena, str, strlen(str));
+}
+
+void arena_reset(Arena *arena) {
+    // Keep one regular-sized block around for the next session, release the rest
+    ArenaBlock *keep = NULL;
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        if (!keep && block->size == arena->block_size) {
+            keep = block;
+        } else {
+            free(block);
+        }
+        block = next;
+    }
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+        keep->last = 0;
+    }
+    arena->head = keep;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+// ------ String interning ------
+
+typedef struct {
+    uint64_t hash;
+    uint64_t length;
+} InternHeader;
+
+static inline const InternHeader *intern_header(const char *interned) {
+    return (const InternHeader *)interned - 1;
+}
+
+uint64_t intern_hash(const char *interned) {
+    return intern_header(interned)->hash;
+}
+
+size_t intern_length(const char *interned) {
+    return (size_t)intern_header(interned)->length;
+}
+
+void string_pool_init(StringPool *pool) {
+    pool->slots = NULL;
+    pool->capacity = 0;
+    pool->size = 0;
+    arena_init(&pool->storage, 0);
+}
+
+// Slot holding str, or the empty slot where it belongs
+static const char **string_pool_slot(const StringPool *pool, const char *str, size_t len, uint64_t hash) {
+    size_t mask = pool->capacity - 1;
+    for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+        const char *candidate = pool->slots[i];
+        if (!candidate) return &pool->slots[i];
+        const InternHeader *header = intern_header(candidate);
+        if (header->hash == hash && header->length == len && memcmp(candidate, str, len) == 0) {
+            return &pool->slots[i];
+        }
+    }
+}
+
+static void string_pool_grow(StringPool *pool) {
+    size_t capacity = pool->capacity ? pool->capacity * 2 : 256;
+    const char **old = pool->slots;
+    size_t old_capacity = pool->capacity;
+    pool->slots = calloc(capacity, sizeof(char *));
+    if (!pool->slots) vector_fail("Failed to allocate memory");
+    pool->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!old[i]) continue;
+        size_t mask = capacity - 1;
+        size_t j = (size_t)intern_hash(old[i]) & mask;
+        while (pool->slots[j]) j = (j + 1) & mask;
+        pool->slots[j] = old[i];
+    }
+    free(old);
+}
+
+const char *string_pool_intern_n(StringPool *pool, const char *str, size_t len) {
+    if ((pool->size + 1) * 4 > pool->capacity * 3) string_pool_grow(pool);
+    uint64_t hash = vector_hash(str, len);
+    const char **slot = string_pool_slot(pool, str, len, hash);
+    if (*slot) return *slot;
+
+    InternHeader *header = arena_alloc(&pool->storage, sizeof(InternHeader) + len + 1);
+    header->hash = hash;
+    header->length = len;
+    char *copy = (char *)(header + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    *slot = copy;
+    pool->size++;
+    return copy;
+}
+
+const char *string_pool_intern(StringPool *pool, const char *str) {
+    return string_pool_intern_n(pool, str, strlen(str));
+}
+
+const char *string_pool_find(const StringPool *pool, const char *str) {
+    if (pool->size == 0) return NULL;
+    size_t len = strlen(str);
+    return *string_pool_slot(pool, str, len, vector_hash(str, len));
+}
+
+size_t string_pool_len(const StringPool *pool) {
+    return pool->size;
+}
+
+void string_pool_free(StringPool *pool) {
+    free(pool->slots);
+    arena_free(&pool->storage);
+    pool->slots = NULL;
+    pool->capacity = 0;
+    pool->size = 0;
+}
+
+static StringPool intern_pool;
+
+static StringPool *intern_global_pool(void) {
+    if (!intern_pool.storage.block_size) string_pool_init(&intern_pool);
+    return &intern_pool;
+}
+
+const char *intern_n(const char *str, size_t len) {
+    return string_pool_intern_n(intern_global_pool(), str, len);
+}
+
+const char *intern(const char *str) {
+    return string_pool_intern(intern_global_pool(), str);
+}
+
+const char *intern_find(const char *str) {
+    return string_pool_find(intern_global_pool(), str);
+}
+
+// ------ HashMap ------
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HASHMAP_SSE2 1
+#endif
+
+#define HASHMAP_GROUP    16
+#define HASHMAP_EMPTY    ((int8_t)-128)
+#define HASHMAP_DELETED  ((int8_t)-2)
+
+static inline uint64_t hashmap_mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+uint64_t vector_hash(const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ (len * 0xff51afd7ed558ccdULL);
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = (h ^ hashmap_mix(word)) * 0x9e3779b97f4a7c15ULL;
+        p += 8;
+        len -= 8;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p, len);
+    return hashmap_mix(h ^ tail);
+}
+
+static inline uint32_t hashmap_ctz(uint32_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(x);
+#else
+    uint32_t n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// Bit i is set when ctrl[i] == byte
+static inline uint32_t hashmap_match(const int8_t *ctrl, int8_t byte) {
+#ifdef HASHMAP_SSE2
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HASHMAP_GROUP; i++) mask |= (uint32_t)(ctrl[i] == byte) << i;
+    return mask;
+#endif
+}
+
+// Bit i is set when ctrl[i] is EMPTY or DELETED (both have the sign bit set, full slots do not)
+static inline uint32_t hashmap_match_free(const int8_t *ctrl) {
+#ifdef HASHMAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HASHMAP_GROUP; i++) mask |= (uint32_t)(ctrl[i] < 0) << i;
+    return mask;
+#endif
+}
+
+static inline uint64_t hashmap_hash(const HashMap *map, const char *str, uint64_t num) {
+    return map->kind == HASHMAP_STRING ? vector_hash(str, strlen(str)) : hashmap_mix(num);
+}
+
+static inline int hashmap_equal(const HashMap *map, const HashMapEntry *entry, const char *str, uint64_t num) {
+    return map->kind == HASHMAP_STRING ? strcmp(entry->key.str, str) == 0 : entry->key.num == num;
+}
+
+// Control bytes of the first group are mirrored after the end so that unaligned loads never wrap
+static inline void hashmap_set_ctrl(HashMap *map, size_t index, int8_t byte) {
+    map->ctrl[index] = byte;
+    if (index < HASHMAP_GROUP) map->ctrl[map->capacity + index] = byte;
+}
+
+static ssize_t hashmap_find(const HashMap *map, const char *str, uint64_t num, uint64_t hash) {
+    if (map->size == 0) return -1;
+    size_t mask = map->capacity - 1;
+    int8_t h2 = (int8_t)(hash & 0x7f);
+    size_t pos = (size_t)(hash >> 7) & mask;
+
+    for (size_t stride = HASHMAP_GROUP; ; stride += HASHMAP_GROUP) {
+        const int8_t *group = map->ctrl + pos;
+        for (uint32_t bits = hashmap_match(group, h2); bits; bits &= bits - 1) {
+            size_t index = (pos + hashmap_ctz(bits)) & mask;
+            if (hashmap_equal(map, &map->slots[index], str, num)) return (ssize_t)index;
+        }
+        if (hashmap_match(group, HASHMAP_EMPTY)) return -1;
+        pos = (pos + stride) & mask;
+    }
+}
+
+static size_t hashmap_find_free(const HashMap *map, uint64_t hash) {
+    size_t mask = map->capacity - 1;
+    size_t pos = (size_t)(hash >> 7) & mask;
+    for (size_t stride = HASHMAP_GROUP; ; stride += HASHMAP_GROUP) {
+        uint32_t bits = hashmap_match_free(map->ctrl + pos);
+        if (bits) return (pos + hashmap_ctz(bits)) & mask;
+        pos = (pos + stride) & mask;
+    }
+}
+
+static void hashmap_allocate(HashMap *map, size_t capacity) {
+    map->ctrl = malloc(capacity + HASHMAP_GROUP);
+    map->slots = malloc(capacity * sizeof(HashMapEntry));
+    if (!map->ctrl || !map->slots) vector_fail("Failed to allocate memory");
+    memset(map->ctrl, HASHMAP_EMPTY, capacity + HASHMAP_GROUP);
+    map->capacity = capacity;
+    map->growth_left = capacity - capacity / 8;
+}
+
+// Moves every entry into a table of `capacity` slots; also drops DELETED markers
+static void hashmap_rehash(HashMap *map, size_t capacity) {
+    HashMap old = *map;
+    hashmap_allocate(map, capacity);
+    map->growth_left -= map->size;
+    for (size_t i = 0; i < old.capacity; i++) {
+        if (old.ctrl[i] < 0) continue;
+        HashMapEntry *entry = &old.slots[i];
+        uint64_t hash = hashmap_hash(map, entry->key.str, entry->key.num);
+        size_t index = hashmap_find_free(map, hash);
+        hashmap_set_ctrl(map, index, (int8_t)(hash & 0x7f));
+        map->slots[index] = *entry;
+    }
+    free(old.ctrl);
+    free(old.slots);
+}
+
+void hashmap_init(HashMap *map, HashMapKind kind) {
+    map->kind = kind;
+    map->size = 0;
+    hashmap_allocate(map, HASHMAP_GROUP);
+}
+
+void hashmap_reserve(HashMap *map, size_t count) {
+    if (!map->ctrl) hashmap_allocate(map, HASHMAP_GROUP);
+    if (count <= map->size + map->growth_left) return;
+    size_t capacity = map->capacity;
+    while (capacity - capacity / 8 < count) capacity *= 2;
+    hashmap_rehash(map, capacity);
+}
+
+static void **hashmap_put(HashMap *map, const char *str, uint64_t num) {
+    if (!map->ctrl) hashmap_allocate(map, HASHMAP_GROUP);
+    uint64_t hash = hashmap_hash(map, str, num);
+    ssize_t found = hashmap_find(map, str, num, hash);
+    if (found >= 0) return &map->slots[found].value;
+
+    size_t index = hashmap_find_free(map, hash);
+    if (map->growth_left == 0 && map->ctrl[index] == HASHMAP_EMPTY) {
+        // Mostly tombstones: clean up in place instead of growing
+        hashmap_rehash(map, map->size * 2 < map->capacity - map->capacity / 8 ? map->capacity : map->capacity * 2);
+        index = hashmap_find_free(map, hash);
+    }
+    if (map->ctrl[index] == HASHMAP_EMPTY) map->growth_left--;
+    hashmap_set_ctrl(map, index, (int8_t)(hash & 0x7f));
+
+    HashMapEntry *entry = &map->slots[index];
+    if (map->kind == HASHMAP_STRING) {
+        entry->key.str = strdup(str);
+        if (!entry->key.str) vector_fail("Failed to allocate memory");
+    } else {
+        entry->key.num = num;
+    }
+    entry->value = NULL;
+    map->size++;
+    return &entry->value;
+}
+
+static bool hashmap_remove(HashMap *map, const char *str, uint64_t num, void **value) {
+    ssize_t index = hashmap_find(map, str, num, hashmap_hash(map, str, num));
+    if (index < 0) return false;
+    if (value) *value = map->slots[index].value;
+    if (map->kind == HASHMAP_STRING) free(map->slots[index].key.str);
+    hashmap_set_ctrl(map, (size_t)index, HASHMAP_DELETED);
+    map->size--;
+    return true;
+}
+
+void **hashmap_put_str(HashMap *map, const char *key) { return hashmap_put(map, key, 0); }
+void *hashmap_get_str(const HashMap *map, const char *key) {
+    ssize_t index = hashmap_find(map, key, 0, vector_hash(key, strlen(key)));
+    return index >= 0 ? map->slots[index].value : NULL;
+}
+bool hashmap_contains_str(const HashMap *map, const char *key) {
+    return hashmap_find(map, key, 0, vector_hash(key, strlen(key))) >= 0;
+}
+bool hashmap_remove_str(HashMap *map, const char *key, void **value) { return hashmap_remove(map, key, 0, value); }
+
+void **hashmap_put_int(HashMap *map, uint64_t key) { return hashmap_put(map, NULL, key); }
+void *hashmap_get_int(const HashMap *map, uint64_t key) {
+    ssize_t index = hashmap_find(map, NULL, key, hashmap_mix(key));
+    return index >= 0 ? map->slots[index].value : NULL;
+}
+bool hashmap_contains_int(const HashMap *map, uint64_t key) {
+    return hashmap_find(map, NULL, key, hashmap_mix(key)) >= 0;
+}
+bool hashmap_remove_int(HashMap *map, uint64_t key, void **value) { return hashmap_remove(map, NULL, key, value); }
+
+bool hashset_add_str(HashMap *set, const char *key) {
+    size_t size = set->size;
+    hashmap_put_str(set, key);
+    return set->size != size;
+}
+
+bool hashset_add_int(HashMap *set, uint64_t key) {
+    size_t size = set->size;
+    hashmap_put_int(set, key);
+    return set->size != size;
+}
+
+size_t hashmap_len(const HashMap *map) {
+    return map->size;
+}
+
+// Iterate with `size_t it = 0; while ((entry = hashmap_next(map, &it)))`
+HashMapEntry *hashmap_next(HashMap *map, size_t *iterator) {
+    while (*iterator < map->capacity) {
+        size_t index = (*iterator)++;
+        if (map->ctrl[index] >= 0) return &map->slots[index];
+    }
+    return NULL;
+}
+
+void hashmap_clear(HashMap *map) {
+    if (!map->ctrl) return;
+    if (map->kind == HASHMAP_STRING) {
+        for (size_t i = 0; i < map->capacity; i++) {
+            if (map->ctrl[i] >= 0) free(map->slots[i].key.str);
+        }
+    }
+    memset(map->ctrl, HASHMAP_EMPTY, map->capacity + HASHMAP_GROUP);
+    map->size = 0;
+    map->growth_left = map->capacity - map->capacity / 8;
+}
+
+void hashmap_free(HashMap *map) {
+    if (!map->ctrl) return;
+    hashmap_clear(map);
+    free(map->ctrl);
+    free(map->slots);
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->capacity = 0;
+    map->growth_left = 0;
+}
+
+// ------ Deque ------
+
+static inline char *deque_slot(const Deque *deque, size_t index) {
+    return (char *)deque->data + ((deque->head + index) & (deque->capacity - 1)) * deque->element_size;
+}
+
+void deque_init(Deque *deque, size_t initial_capacity, size_t element_size) {
+    size_t capacity = 8;
+    while (capacity < initial_capacity) capacity *= 2;
+    deque->data = malloc(capacity * element_size);
+    if (!deque->data) vector_fail("Failed to allocate memory");
+    deque->head = 0;
+    deque->size = 0;
+    deque->capacity = capacity;
+    deque->element_size = element_size;
+}
+
+void deque_reserve(Deque *deque, size_t capacity) {
+    if (capacity <= deque->capacity) return;
+    size_t new_capacity = deque->capacity ? deque->capacity : 8;
+    while (new_capacity < capacity) new_capacity *= 2;
+    char *data = realloc(deque->data, new_capacity * deque->element_size);
+    if (!data) vector_fail("Failed to reallocate memory");
+    // A wrapped run [head, old capacity) moves to the end of the larger buffer
+    size_t tail_run = deque->capacity - deque->head;
+    if (deque->size > tail_run) {
+        size_t new_head = new_capacity - tail_run;
+        memmove(data + new_head * deque->element_size, data + deque->head * deque->element_size, tail_run * deque->element_size);
+        deque->head = new_head;
+    }
+    deque->data = data;
+    deque->capacity = new_capacity;
+}
+
+void deque_push_back(Deque *deque, const void *value) {
+    if (VECTOR_UNLIKELY(deque->size == deque->capacity)) deque_reserve(deque, deque->size + 1);
+    memcpy(deque_slot(deque, deque->size), value, deque->element_size);
+    deque->size++;
+}
+
+void deque_push_front(Deque *deque, const void *value) {
+    if (VECTOR_UNLIKELY(deque->size == deque->capacity)) deque_reserve(deque, deque->size + 1);
+    deque->head = (deque->head - 1) & (deque->capacity - 1);
+    memcpy(deque_slot(deque, 0), value, deque->element_size);
+    deque->size++;
+}
+
+bool deque_pop_front(Deque *deque, void *out) {
+    if (deque->size == 0) return false;
+    if (out) memcpy(out, deque_slot(deque, 0), deque->element_size);
+    deque->head = (deque->head + 1) & (deque->capacity - 1);
+    deque->size--;
+    return true;
+}
+
+bool deque_pop_back(Deque *deque, void *out) {
+    if (deque->size == 0) return false;
+    deque->size--;
+    if (out) memcpy(out, deque_slot(deque, deque->size), deque->element_size);
+    return true;
+}
+
+void deque_push_back_many(Deque *deque, const void *values, size_t count) {
+    deque_reserve(deque, deque->size + count);
+    // At most two memcpys: up to the end of the buffer, then from its start
+    size_t tail = (deque->head + deque->size) & (deque->capacity - 1);
+    size_t first = deque->capacity - tail < count ? deque->capacity - tail : count;
+    memcpy((char *)deque->data + tail * deque->element_size, values, first * deque->element_size);
+    memcpy(deque->data, (const char *)values + first * deque->element_size, (count - first) * deque->element_size);
+    deque->size += count;
+}
+
+size_t deque_pop_front_many(Deque *deque, void *out, size_t max) {
+    size_t count = max < deque->size ? max : deque->size;
+    size_t first = deque->capacity - deque->head < count ? deque->capacity - deque->head : count;
+    memcpy(out, (char *)deque->data + deque->head * deque->element_size, first * deque->element_size);
+    memcpy((char *)out + first * deque->element_size, deque->data, (count - first) * deque->element_size);
+    deque->head = (deque->head + count) & (deque->capacity - 1);
+    deque->size -= count;
+    return count;
+}
+
+void *deque_get(Deque *deque, size_t index) {
+    if (VECTOR_UNLIKELY(index >= deque->size)) vector_fail("Index out of bounds");
+    return deque_slot(deque, index);
+}
+
+void *deque_front(Deque *deque) {
+    return deque->size ? deque_slot(deque, 0) : NULL;
+}
+
+void *deque_back(Deque *deque) {
+    return deque->size ? deque_slot(deque, deque->size - 1) : NULL;
+}
+
+size_t deque_len(const Deque *deque) {
+    return deque->size;
+}
+
+void *deque_next(Deque *deque, size_t *iterator) {
+    if (*iterator >= deque->size) return NULL;
+    return deque_slot(deque, (*iterator)++);
+}
+
+void deque_clear(Deque *deque) {
+    deque->head = 0;
+    deque->size = 0;
+}
+
+void deque_free(Deque *deque) {
+    free(deque->data);
+    deque->data = NULL;
+    deque->head = 0;
+    deque->size = 0;
+    deque->capacity = 0;
+}
+
 Vector parse_pargs(int argc, char **argv) {
     Vector pargs_vector;
-    vector_init(&pargs_vector, 3, sizeof(char *));
-    for (int i = 0; i < argc; i++) {
-        char *arg = strdup(argv[i]);
-        vector_push(&pargs_vector, &arg);
-    }
+    vector_init_ops(&pargs_vector, argc > 0 ? argc : 1, sizeof(char *), &vector_ops_string_borrowed);
+    if (argc > 0) memcpy(pargs_vector.data, argv, (size_t)argc * sizeof(char *));
+    pargs_vector.size = argc > 0 ? argc : 0;
 
     return pargs_vector;
 }
 
 Vector split_to_vector(const char* src, const char* delimiter) {
-    char* src_copy = strdup(src);
-    if (!src_copy) {
-        fprintf(stderr, "Failed to duplicate source string\n");
-        exit(EXIT_FAILURE);
-    }
+    Vector tokens;
+    vector_init_ops(&tokens, 16, sizeof(Token), &vector_ops_plain);
+    vector_tokenize(&tokens, src, strlen(src), delimiter, TOKENIZE_PLAIN);
 
-    char* token;
     Vector result;
-    vector_init(&result, 10, sizeof(char *));
-
-    token = strtok(src_copy, delimiter);
-    while (token != NULL) {
-        char *token_copy = strdup(token);
-        if (!token_copy) {
-            fprintf(stderr, "Failed to duplicate token\n");
-            free(src_copy);
-            vector_free(&result);
-            exit(EXIT_FAILURE);
-        }
-        vector_push(&result, &token_copy);
-        token = strtok(NULL, delimiter);
+    vector_init(&result, tokens.size, sizeof(char *));
+    Token *slices = tokens.data;
+    char **strings = result.data;
+    for (size_t i = 0; i < tokens.size; i++) {
+        strings[i] = token_dup(&slices[i], TOKENIZE_PLAIN);
     }
+    result.size = tokens.size;
 
-    free(src_copy);
+    vector_free(&tokens);
     return result;
 }
 
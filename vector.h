@@ -5,33 +5,387 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
 
+// Where a Vector gets its memory. NULL means malloc/realloc/free. Sizes are passed back on realloc
+// and free so allocators that do not track them (like Arena) can still move and release blocks.
 typedef struct {
+    void *(*alloc)(void *context, size_t size);
+    void *(*realloc)(void *context, void *pointer, size_t old_size, size_t new_size);
+    void (*free)(void *context, void *pointer, size_t size);
+    void *context;
+} VectorAllocator;
+
+typedef struct Vector Vector;
+
+// What a vector does with its elements. Any hook may be NULL: no destroy means the vector does not
+// own what its elements point to, no copy means vector_copy is a memcpy and no compare means
+// vector_find/vector_contains compare bytes. Vectors without an ops table keep the old guess:
+// pointer-sized elements are owned strings, sizeof(Vector)-sized ones nested vectors.
+typedef struct {
+    void (*destroy)(Vector *vector, void *element);
+    void (*copy)(Vector *dest, void *element, const void *source);
+    int (*compare)(const void *a, const void *b);
+} VectorOps;
+
+// Bumped whenever struct Vector changes. ABI 2 added allocator and ops; objects built against the
+// four-field ABI 1 layout must be rebuilt, which the libsamba.so.2 soname enforces
+#define VECTOR_ABI_VERSION 2
+
+struct Vector {
     void *data;
     size_t size;
     size_t capacity;
     size_t element_size;
-} Vector;
+    const VectorAllocator *allocator;
+    const VectorOps *ops;
+};
+
+// char * elements the vector owns: freed by vector_free, duplicated by vector_copy
+extern const VectorOps vector_ops_string;
+// char * elements borrowed from somewhere that outlives the vector (argv, a mapped file, a pool)
+extern const VectorOps vector_ops_string_borrowed;
+// Vector elements, freed with vector_free
+extern const VectorOps vector_ops_vector;
+// Plain values: nothing to destroy, byte-wise copy and compare
+extern const VectorOps vector_ops_plain;
 
 void vector_init(Vector *vector, size_t initial_capacity, size_t element_size);
+// Like vector_init, but the buffer (and the strings vector_free releases) go through `allocator`
+void vector_init_with(Vector *vector, size_t initial_capacity, size_t element_size, const VectorAllocator *allocator);
+// Like vector_init, with an explicit ops table instead of the size-based ownership guess
+void vector_init_ops(Vector *vector, size_t initial_capacity, size_t element_size, const VectorOps *ops);
 void vector_resize(Vector *vector, size_t new_capacity);
+void vector_reserve(Vector *vector, size_t capacity);
 void vector_push(Vector *vector, const void *value);
+void vector_extend(Vector *vector, const void *values, size_t count);
+void vector_insert_range(Vector *vector, size_t index, const void *values, size_t count);
 void *vector_get(Vector *vector, size_t index);
 void vector_set(Vector *vector, size_t index, const void *value);
+// String vectors (pointer-sized without ops, or vector_compare_string ops) take the string itself;
+// with any other ops table `value` points at an element
 bool vector_contains(Vector *vector, const void *value);
 void vector_remove(Vector *vector, size_t index);
 ssize_t vector_find(Vector *vector, const void *value);
 void vector_compress(Vector *vector);
+void vector_shrink_to_fit(Vector *vector);
 void vector_copy(Vector *dest, const Vector *src);
 void vector_free(Vector *vector);
 size_t vector_len(Vector *vector);
 void *vector_pop(Vector *vector);
 
+// indexes[j] = vector_find(vector, values + j): one pass over the vector for large batches
+void vector_find_many(Vector *vector, const void *values, size_t count, ssize_t *indexes);
+
+// Comparators for vector_sort/vector_bsearch; vector_sort recognises both and takes a faster path.
+// vector_compare_string compares char * elements (pointers to char *), vector_compare_int ints.
+int vector_compare_string(const void *a, const void *b);
+int vector_compare_int(const void *a, const void *b);
+
+// Introsort by compare, or by the ops table's compare when it is NULL. Not stable.
+void vector_sort(Vector *vector, int (*compare)(const void *, const void *));
+// 4- or 8-byte integer elements, radix sorted (stable)
+void vector_sort_ints(Vector *vector, bool is_signed);
+// char * elements in strcmp order
+void vector_sort_strings(Vector *vector);
+// On a vector sorted by compare: index of the first element not less than *key (size if none)
+size_t vector_lower_bound(Vector *vector, const void *key, int (*compare)(const void *, const void *));
+// Index of an element equal to *key, or -1
+ssize_t vector_bsearch(Vector *vector, const void *key, int (*compare)(const void *, const void *));
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VECTOR_NORETURN __attribute__((noreturn, cold))
+#define VECTOR_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define VECTOR_NORETURN
+#define VECTOR_UNLIKELY(x) (x)
+#endif
+
+VECTOR_NORETURN void vector_fail(const char *message);
+
+// Capacity grows by this factor (default 2.0) whenever a vector runs out of room
+void vector_set_growth_factor(double factor);
+size_t vector_grow_capacity(size_t capacity, size_t needed);
+
+// Typed vector: VECTOR_DEFINE(Ints, int) declares `Ints` and static inline Ints_init/push/at/get/set/pop/len/free.
+// Elements are assigned, not memcpy'd, and only the growth and error paths leave the caller.
+#define VECTOR_DEFINE(name, T) \
+    typedef struct { \
+        T *data; \
+        size_t size; \
+        size_t capacity; \
+    } name; \
+    static inline void name##_init(name *vector, size_t initial_capacity) { \
+        if (initial_capacity == 0) initial_capacity = 1; \
+        vector->data = (T *)malloc(initial_capacity * sizeof(T)); \
+        if (!vector->data) vector_fail("Failed to allocate memory"); \
+        vector->size = 0; \
+        vector->capacity = initial_capacity; \
+    } \
+    static inline void name##_reserve(name *vector, size_t capacity) { \
+        if (capacity <= vector->capacity) return; \
+        T *data = (T *)realloc(vector->data, capacity * sizeof(T)); \
+        if (!data) vector_fail("Failed to reallocate memory"); \
+        vector->data = data; \
+        vector->capacity = capacity; \
+    } \
+    static inline void name##_push(name *vector, T value) { \
+        if (VECTOR_UNLIKELY(vector->size == vector->capacity)) { \
+            name##_reserve(vector, vector_grow_capacity(vector->capacity, vector->size + 1)); \
+        } \
+        vector->data[vector->size++] = value; \
+    } \
+    static inline T *name##_at(name *vector, size_t index) { \
+        if (VECTOR_UNLIKELY(index >= vector->size)) vector_fail("Index out of bounds"); \
+        return &vector->data[index]; \
+    } \
+    static inline T name##_get(name *vector, size_t index) { \
+        return *name##_at(vector, index); \
+    } \
+    static inline void name##_set(name *vector, size_t index, T value) { \
+        *name##_at(vector, index) = value; \
+    } \
+    static inline T name##_pop(name *vector) { \
+        if (VECTOR_UNLIKELY(vector->size == 0)) vector_fail("Vector is empty"); \
+        return vector->data[--vector->size]; \
+    } \
+    static inline size_t name##_len(const name *vector) { \
+        return vector->size; \
+    } \
+    static inline void name##_free(name *vector) { \
+        free(vector->data); \
+        vector->data = NULL; \
+        vector->size = 0; \
+        vector->capacity = 0; \
+    }
+
+// Small vector: SMALL_VECTOR_DEFINE(Args, char *, 16) declares `Args` with room for 16 elements
+// inside the struct, so it only touches the heap once it outgrows them. `data` points at the
+// inline buffer until then, which means an initialized small vector must not be copied or moved.
+#define SMALL_VECTOR_DEFINE(name, T, N) \
+    typedef struct { \
+        T *data; \
+        size_t size; \
+        size_t capacity; \
+        T inline_data[N]; \
+    } name; \
+    static inline void name##_init(name *vector) { \
+        vector->data = vector->inline_data; \
+        vector->size = 0; \
+        vector->capacity = N; \
+    } \
+    static inline bool name##_is_inline(const name *vector) { \
+        return vector->data == vector->inline_data; \
+    } \
+    static inline void name##_reserve(name *vector, size_t capacity) { \
+        if (capacity <= vector->capacity) return; \
+        T *data; \
+        if (name##_is_inline(vector)) { \
+            data = (T *)malloc(capacity * sizeof(T)); \
+            if (data) memcpy(data, vector->inline_data, vector->size * sizeof(T)); \
+        } else { \
+            data = (T *)realloc(vector->data, capacity * sizeof(T)); \
+        } \
+        if (!data) vector_fail("Failed to reallocate memory"); \
+        vector->data = data; \
+        vector->capacity = capacity; \
+    } \
+    static inline void name##_push(name *vector, T value) { \
+        if (VECTOR_UNLIKELY(vector->size == vector->capacity)) { \
+            name##_reserve(vector, vector_grow_capacity(vector->capacity, vector->size + 1)); \
+        } \
+        vector->data[vector->size++] = value; \
+    } \
+    static inline T *name##_at(name *vector, size_t index) { \
+        if (VECTOR_UNLIKELY(index >= vector->size)) vector_fail("Index out of bounds"); \
+        return &vector->data[index]; \
+    } \
+    static inline T name##_get(name *vector, size_t index) { \
+        return *name##_at(vector, index); \
+    } \
+    static inline void name##_set(name *vector, size_t index, T value) { \
+        *name##_at(vector, index) = value; \
+    } \
+    static inline T name##_pop(name *vector) { \
+        if (VECTOR_UNLIKELY(vector->size == 0)) vector_fail("Vector is empty"); \
+        return vector->data[--vector->size]; \
+    } \
+    static inline size_t name##_len(const name *vector) { \
+        return vector->size; \
+    } \
+    static inline void name##_free(name *vector) { \
+        if (!name##_is_inline(vector)) free(vector->data); \
+        name##_init(vector); \
+    }
+
 #define VECTOR_FOR_EACH(type, element, vector) \
     for (type *element = (type *)(vector)->data; \
          (char *)element < (char *)(vector)->data + (vector)->size * (vector)->element_size; \
          element++)
 
+// ------ Tokenizer ------
+// Splits text into slices of the original buffer without copying it. Runs of delimiters separate
+// tokens and empty tokens are never produced. SHELL also keeps '...', "..." and backslash escapes
+// inside one token; DEPFILE understands Make's `\ `, `\#`, `$$` and backslash-newline
+// continuations and marks every target of a rule, i.e. all tokens before its colon (the colon is
+// not part of a slice).
+// Slices that contain quoting or escapes are flagged; token_unescape/token_dup resolve them.
+typedef enum {
+    TOKENIZE_PLAIN,
+    TOKENIZE_SHELL,
+    TOKENIZE_DEPFILE,
+} TokenizeMode;
+
+#define TOKEN_ESCAPED 1u
+#define TOKEN_TARGET  2u
+
+typedef struct {
+    const char *data;
+    size_t len;
+    unsigned flags;
+} Token;
+
+// Appends to `tokens` (a vector of Token) and returns how many were added
+size_t vector_tokenize(Vector *tokens, const char *src, size_t len, const char *delimiters, TokenizeMode mode);
+// Writes the token with its quoting resolved to dest (at least token->len + 1 bytes), returns its length
+size_t token_unescape(const Token *token, TokenizeMode mode, char *dest);
+char *token_dup(const Token *token, TokenizeMode mode);
+
+// ------ Arena ------
+// Bump allocator for memory that lives as long as a build session: allocations are carved out of
+// large blocks and released all at once by arena_reset or arena_free. Growing the most recent
+// allocation happens in place. Not thread-safe; an Arena must not be moved once initialized,
+// because its allocator points back at it.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+    size_t block_size;
+    VectorAllocator allocator;
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_realloc(Arena *arena, void *pointer, size_t old_size, size_t new_size);
+char *arena_strdup(Arena *arena, const char *str);
+char *arena_strndup(Arena *arena, const char *str, size_t len);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+// For vector_init_with: the vector's buffer and strings then belong to the arena
+const VectorAllocator *arena_allocator(Arena *arena);
+
+// ------ String interning ------
+// One canonical, immutable copy per distinct string, packed into arena blocks. Interned strings
+// compare equal exactly when their pointers do, and carry their hash and length with them.
+// A StringPool must not be moved once initialized. Not thread-safe.
+typedef struct {
+    const char **slots;
+    size_t capacity;
+    size_t size;
+    Arena storage;
+} StringPool;
+
+void string_pool_init(StringPool *pool);
+const char *string_pool_intern(StringPool *pool, const char *str);
+const char *string_pool_intern_n(StringPool *pool, const char *str, size_t len);
+// The interned copy of str, or NULL if it was never interned
+const char *string_pool_find(const StringPool *pool, const char *str);
+size_t string_pool_len(const StringPool *pool);
+void string_pool_free(StringPool *pool);
+
+// Only valid on strings returned by an intern function
+uint64_t intern_hash(const char *interned);
+size_t intern_length(const char *interned);
+
+// The process-wide pool; its strings live until exit
+const char *intern(const char *str);
+const char *intern_n(const char *str, size_t len);
+const char *intern_find(const char *str);
+
+// ------ HashMap ------
+// SwissTable-style open addressing: one control byte per slot (EMPTY, DELETED or 7 bits of the
+// hash), probed 16 at a time with SSE2 where available. Keys are either strings (copied and owned
+// by the map) or 64-bit integers; values are pointers the map does not own. A set is a map whose
+// values are unused. A zero-initialized HashMap is an empty string map.
+typedef enum {
+    HASHMAP_STRING,
+    HASHMAP_INT,
+} HashMapKind;
+
+typedef struct {
+    union {
+        char *str;
+        uint64_t num;
+    } key;
+    void *value;
+} HashMapEntry;
+
+typedef struct {
+    int8_t *ctrl;
+    HashMapEntry *slots;
+    size_t capacity;
+    size_t size;
+    size_t growth_left;
+    HashMapKind kind;
+} HashMap;
+
+void hashmap_init(HashMap *map, HashMapKind kind);
+void hashmap_reserve(HashMap *map, size_t count);
+void hashmap_free(HashMap *map);
+void hashmap_clear(HashMap *map);
+size_t hashmap_len(const HashMap *map);
+HashMapEntry *hashmap_next(HashMap *map, size_t *iterator);
+
+void **hashmap_put_str(HashMap *map, const char *key);
+void *hashmap_get_str(const HashMap *map, const char *key);
+bool hashmap_contains_str(const HashMap *map, const char *key);
+bool hashmap_remove_str(HashMap *map, const char *key, void **value);
+
+void **hashmap_put_int(HashMap *map, uint64_t key);
+void *hashmap_get_int(const HashMap *map, uint64_t key);
+bool hashmap_contains_int(const HashMap *map, uint64_t key);
+bool hashmap_remove_int(HashMap *map, uint64_t key, void **value);
+
+// Set helpers: true if the key was not in the set before
+bool hashset_add_str(HashMap *set, const char *key);
+bool hashset_add_int(HashMap *set, uint64_t key);
+
+uint64_t vector_hash(const void *data, size_t len);
+
+// ------ Deque ------
+// Ring buffer with a power-of-two capacity: O(1) push and pop at both ends, for FIFO job and event
+// queues where vector_remove(v, 0) would move the whole array. Elements are copied in and out;
+// the deque never owns what they point to. Not thread-safe: guard it with the queue's own lock.
+typedef struct {
+    void *data;
+    size_t head;
+    size_t size;
+    size_t capacity;
+    size_t element_size;
+} Deque;
+
+void deque_init(Deque *deque, size_t initial_capacity, size_t element_size);
+void deque_reserve(Deque *deque, size_t capacity);
+void deque_push_back(Deque *deque, const void *value);
+void deque_push_front(Deque *deque, const void *value);
+// Copy the removed element to `out` (which may be NULL); false if the deque was empty
+bool deque_pop_front(Deque *deque, void *out);
+bool deque_pop_back(Deque *deque, void *out);
+void deque_push_back_many(Deque *deque, const void *values, size_t count);
+// Moves up to `max` elements from the front into `out`, returns how many
+size_t deque_pop_front_many(Deque *deque, void *out, size_t max);
+// Index 0 is the front
+void *deque_get(Deque *deque, size_t index);
+void *deque_front(Deque *deque);
+void *deque_back(Deque *deque);
+size_t deque_len(const Deque *deque);
+// Front-to-back iteration: start with *iterator = 0, NULL at the end
+void *deque_next(Deque *deque, size_t *iterator);
+void deque_clear(Deque *deque);
+void deque_free(Deque *deque);
+
+// Borrows argv: the strings are not copied and vector_free leaves them alone
 Vector parse_pargs(int argc, char **argv);
 Vector split_to_vector(const char* src, const char* delimiter);
 char *vector_get_str(Vector *vector, size_t index);